@@ -0,0 +1,31 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+
+/* Streams every raw accelerometer sample (100 per second) over USB Serial as binary frames, decode them on the
+ * computer with tools/AccelDecode (e.g. 'AccelDecode /dev/ttyACM0 > samples.csv').  Nothing is formatted on the
+ * Photon and writing never waits for the computer, samples the ring can't hold are counted as dropped. */
+
+BetterPhotonButton bb = BetterPhotonButton();
+PhotonADXL362Accel *accel;
+
+byte frames[ADXL_FRAME_BYTES(ADXL_SAMPLE_RING_SIZE)];
+
+
+/*
+ * setup/loop
+ */
+
+void setup() {
+    Serial.begin(9600);
+    bb.setup();
+    accel = bb.startAccelerometer();
+    accel->setFIFO(PhotonADXL362Accel::ODR_100, 10);  // 100 samples per second, read 10 at a time
+}
+
+void loop() {
+    bb.update(millis());
+    int room = min(Serial.availableForWrite(), (int) sizeof(frames));
+    int length = accel->encodeSamples(frames, room);
+    if (length) Serial.write(frames, (size_t) length);
+}
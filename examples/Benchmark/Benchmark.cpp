@@ -0,0 +1,129 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+#if PLATFORM_ID == 3
+#include <chrono>
+#endif
+#include <new>
+
+/* Times every built-in animation with every built-in palette at several pixel counts (and the WS2812 SPI
+ * encoder) and prints CSV over Serial, so runs from different releases can be diffed.  On the Photon the
+ * times come from the cycle counter, on the host build from the system clock. */
+
+#define BENCHMARK_FRAMES 120  // 2 cycles at 60 fps
+#define BENCHMARK_CYCLE 1000
+#define BENCHMARK_MAX_PIXELS 1000
+
+struct BenchmarkAnimation {
+    const char *name;
+    PixelAnimation *animation;
+};
+
+struct BenchmarkPalette {
+    const char *name;
+    PixelPalette *palette;
+};
+
+const BenchmarkAnimation animations[] = {
+        { "blink", &animation_blink }, { "alternating", &animation_alternating },
+        { "fadeIn", &animation_fadeIn }, { "fadeOut", &animation_fadeOut }, { "glow", &animation_glow },
+        { "strobe", &animation_strobe }, { "sparkle", &animation_sparkle }, { "fader", &animation_fader },
+        { "cycle", &animation_cycle }, { "random", &animation_random }, { "increment", &animation_increment },
+        { "decrement", &animation_decrement }, { "bounce", &animation_bounce }, { "scanner", &animation_scanner },
+        { "comet", &animation_comet }, { "bars", &animation_bars }, { "gradient", &animation_gradient },
+};
+
+const BenchmarkPalette palettes[] = {
+        { "BW", &paletteBW }, { "RGB", &paletteRGB }, { "RYGB", &paletteRYGB },
+        { "RYGBStripe", &paletteRYGBStripe }, { "Rainbow", &paletteRainbow },
+};
+
+const int pixelCounts[] = { 11, 60, 300, 1000 };
+
+PixelColor benchmarkPixels[BENCHMARK_MAX_PIXELS];
+byte spiBuffer[BENCHMARK_MAX_PIXELS * PIXEL_SPI_BYTES_PER_PIXEL];
+
+/* heap allocations, counted so an animation that starts allocating shows up */
+volatile unsigned long allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    void *memory = malloc(size ? size : 1);
+    if (!memory) abort();
+    return memory;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void *memory) noexcept { free(memory); }
+
+void operator delete[](void *memory) noexcept { free(memory); }
+
+/* a monotonic time in nanoseconds */
+uint64_t nanos() {
+#if PLATFORM_ID == 3
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    static uint32_t lastTicks = System.ticks();
+    static uint64_t ticks = 0;
+    uint32_t now = System.ticks();
+    ticks += now - lastTicks;  // the 32 bit cycle counter wraps every ~36s
+    lastTicks = now;
+    return ticks * 1000 / System.ticksPerMicrosecond();
+#endif
+}
+
+void report(const char *benchmark, const char *palette, int pixelCount, uint64_t elapsed, unsigned long allocated) {
+    unsigned long perFrame = (unsigned long) (elapsed / BENCHMARK_FRAMES);
+    Serial.printlnf("%s,%s,%d,%d,%lu,%lu,%lu", benchmark, palette, pixelCount, BENCHMARK_FRAMES,
+                    perFrame, perFrame / pixelCount, allocated);
+}
+
+void benchmarkAnimation(const BenchmarkAnimation &animation, const BenchmarkPalette &palette, int pixelCount) {
+    PixelAnimationData data = PixelAnimationData();
+    data.pixelCount = pixelCount;
+    data.pixels = benchmarkPixels;
+    data.palette = palette.palette;
+    data.cycleMillis = BENCHMARK_CYCLE;
+    data.start = 0;
+    data.stop = 0;
+    data.temp = 0;
+
+    unsigned long allocated = allocations;
+    uint64_t started = nanos();
+    for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        data.updated = (unsigned long) frame * 2 * BENCHMARK_CYCLE / BENCHMARK_FRAMES;
+        animation.animation(&data);
+    }
+    report(animation.name, palette.name, pixelCount, nanos() - started, allocations - allocated);
+}
+
+void benchmarkEncode(int pixelCount) {
+    unsigned long allocated = allocations;
+    uint64_t started = nanos();
+    for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        ws2812Encode(benchmarkPixels, pixelCount, spiBuffer);
+    }
+    report("ws2812Encode", "-", pixelCount, nanos() - started, allocations - allocated);
+}
+
+void setup() {
+    Serial.begin(9600);
+#if PLATFORM_ID != 3
+    while (!Serial.isConnected() && millis() < 10000) Particle.process();  // give the USB serial a chance to open
+#endif
+    Serial.printlnf("benchmark,palette,pixels,frames,ns_per_frame,ns_per_pixel,allocations");
+    for (int count : pixelCounts) {
+        for (const BenchmarkAnimation &animation : animations) {
+            for (const BenchmarkPalette &palette : palettes) {
+                benchmarkAnimation(animation, palette, count);
+            }
+        }
+        benchmarkEncode(count);
+    }
+    Serial.printlnf("done");
+}
+
+void loop() {
+}
@@ -0,0 +1,253 @@
+/*
+ * Host (Linux) simulation of the Photon: clock, gpio, tone, random, System and the HAL pin map, plus main().
+ */
+
+#include "HostSimulation.h"
+#include "pinmap_impl.h"
+#include <vector>
+#include <algorithm>
+
+#define HOST_READ_NANOS 100  // time a millis()/micros() read takes
+#define HOST_TICK_NANOS 8  // time a System.ticks() read takes (~1 tick at 120MHz)
+
+struct HostPin {
+    PinMode mode;
+    uint8_t output;
+    bool hasInput;
+    uint8_t input;
+    unsigned int tone;
+    wiring_interrupt_handler_t handler;
+    InterruptMode edge;
+};
+
+struct HostScheduledInput {
+    system_tick_t atMillis;
+    pin_t pin;
+    uint8_t value;
+
+    bool operator < (const HostScheduledInput &other) const { return atMillis < other.atMillis; }
+};
+
+static uint64_t nanos = 0;
+static HostPin pins[TOTAL_PINS];
+static std::vector<HostScheduledInput> scheduled;  // sorted by time
+static system_tick_t runMillis = 0;  // 0 = forever
+static unsigned long loopMicros = 1000;
+
+USBSerial Serial;
+SPIClass SPI(0);
+SPIClass SPI1(1);
+SystemClass System;
+
+/*************************
+ * time
+ */
+
+uint64_t hostNanos() { return nanos; }
+
+void hostAdvanceNanos(uint64_t value) { nanos += value; }
+
+system_tick_t millis() {
+    nanos += HOST_READ_NANOS;
+    return (system_tick_t) (nanos / 1000000);
+}
+
+unsigned long micros() {
+    nanos += HOST_READ_NANOS;
+    return (unsigned long) (nanos / 1000);
+}
+
+void delay(unsigned long ms) {
+    nanos += (uint64_t) ms * 1000000;
+    hostApplyScheduledInputs();
+}
+
+void delayMicroseconds(unsigned int us) {
+    nanos += (uint64_t) us * 1000;
+}
+
+uint32_t SystemClass::ticks() {
+    nanos += HOST_TICK_NANOS;
+    return (uint32_t) (nanos * ticksPerMicrosecond() / 1000);
+}
+
+/*************************
+ * gpio
+ */
+
+static void updateInputRegister(pin_t pin);
+
+static uint8_t pinLevel(pin_t pin) {
+    const HostPin &state = pins[pin];
+    if (state.hasInput) return state.input;
+    switch (state.mode) {
+        case OUTPUT: return state.output;
+        case INPUT_PULLUP: return HIGH;
+        default: return LOW;
+    }
+}
+
+static void changePin(pin_t pin, bool hasInput, uint8_t value) {
+    if (pin >= TOTAL_PINS) return;
+    uint8_t before = pinLevel(pin);
+    pins[pin].hasInput = hasInput;
+    pins[pin].input = value;
+    uint8_t after = pinLevel(pin);
+    updateInputRegister(pin);
+    HostPin &state = pins[pin];
+    if (state.handler && before != after &&
+        (state.edge == CHANGE || (state.edge == RISING) == (after == HIGH))) {
+        (*state.handler)();
+    }
+}
+
+void pinMode(pin_t pin, PinMode mode) {
+    if (pin >= TOTAL_PINS) return;
+    pins[pin].mode = mode;
+    updateInputRegister(pin);
+}
+
+void digitalWrite(pin_t pin, uint8_t value) {
+    if (pin >= TOTAL_PINS) return;
+    pins[pin].output = value ? HIGH : LOW;
+    updateInputRegister(pin);
+    if (pin == HOST_ACCEL_CS_PIN) hostAccelSelect(value == LOW);
+}
+
+int32_t digitalRead(pin_t pin) {
+    return pin < TOTAL_PINS ? pinLevel(pin) : LOW;
+}
+
+void tone(pin_t pin, unsigned int frequency, unsigned long duration) {
+    (void) duration;
+    if (pin < TOTAL_PINS) pins[pin].tone = frequency;
+}
+
+void noTone(pin_t pin) {
+    if (pin < TOTAL_PINS) pins[pin].tone = 0;
+}
+
+// like the Photon's EXTI, one handler per line and the line is the pin's number within its port, so e.g. A1 (PC3)
+// can't have an interrupt while D4 (PB3) has one
+bool attachInterrupt(pin_t pin, wiring_interrupt_handler_t handler, InterruptMode mode) {
+    STM32_Pin_Info *map = HAL_Pin_Map();
+    if (pin >= TOTAL_PINS || !map[pin].gpio_peripheral) return false;
+    for (pin_t other = 0; other < TOTAL_PINS; other++) {
+        if (other != pin && pins[other].handler && map[other].gpio_peripheral &&
+            map[other].gpio_pin_source == map[pin].gpio_pin_source) return false;
+    }
+    pins[pin].handler = handler;
+    pins[pin].edge = mode;
+    return true;
+}
+
+void detachInterrupt(pin_t pin) {
+    if (pin < TOTAL_PINS) pins[pin].handler = NULL;
+}
+
+void interrupts() { }
+
+void noInterrupts() { }
+
+void hostSetPinInput(pin_t pin, uint8_t value) { changePin(pin, true, value ? HIGH : LOW); }
+
+void hostClearPinInput(pin_t pin) { changePin(pin, false, LOW); }
+
+void hostSchedulePinInput(system_tick_t atMillis, pin_t pin, uint8_t value) {
+    HostScheduledInput input = { atMillis, pin, value };
+    scheduled.insert(std::upper_bound(scheduled.begin(), scheduled.end(), input), input);
+}
+
+void hostApplyScheduledInputs() {
+    system_tick_t now = (system_tick_t) (nanos / 1000000);
+    while (!scheduled.empty() && scheduled.front().atMillis <= now) {
+        HostScheduledInput input = scheduled.front();
+        scheduled.erase(scheduled.begin());
+        hostSetPinInput(input.pin, input.value);
+    }
+    hostAccelUpdate();
+}
+
+uint8_t hostPinOutput(pin_t pin) { return pin < TOTAL_PINS ? pins[pin].output : LOW; }
+
+unsigned int hostToneFrequency(pin_t pin) { return pin < TOTAL_PINS ? pins[pin].tone : 0; }
+
+/*************************
+ * random
+ */
+
+long random(long max) {
+    return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max) {
+    return min < max ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned int seed) {
+    srand(seed);
+}
+
+/*************************
+ * HAL pin map, the registers are plain memory so the WS2812 bit-bang code has somewhere to write and the input
+ * data registers follow the simulated pin levels
+ */
+
+static GPIO_TypeDef ports[3];
+
+static STM32_Pin_Info pinMap[TOTAL_PINS] = {
+        { &ports[1], 1 << 7, 7 }, { &ports[1], 1 << 6, 6 }, { &ports[1], 1 << 5, 5 }, { &ports[1], 1 << 4, 4 },
+        { &ports[1], 1 << 3, 3 }, { &ports[0], 1 << 15, 15 }, { &ports[0], 1 << 14, 14 }, { &ports[0], 1 << 13, 13 },
+        { NULL, 0, 0 }, { NULL, 0, 0 },
+        { &ports[2], 1 << 5, 5 }, { &ports[2], 1 << 3, 3 }, { &ports[2], 1 << 2, 2 }, { &ports[0], 1 << 5, 5 },
+        { &ports[0], 1 << 6, 6 }, { &ports[0], 1 << 7, 7 }, { &ports[0], 1 << 4, 4 }, { &ports[0], 1 << 0, 0 },
+        { &ports[0], 1 << 10, 10 }, { &ports[0], 1 << 9, 9 },
+};
+
+STM32_Pin_Info *HAL_Pin_Map() { return pinMap; }
+
+// keep the port's input data register in step with the pin's level, for code that reads ports directly
+static void updateInputRegister(pin_t pin) {
+    STM32_Pin_Info &info = pinMap[pin];
+    if (!info.gpio_peripheral) return;
+    if (pinLevel(pin)) info.gpio_peripheral->IDR |= info.gpio_pin;
+    else info.gpio_peripheral->IDR &= ~(uint32_t) info.gpio_pin;
+}
+
+/*************************
+ * main
+ */
+
+void hostParseArguments(int argc, char **argv) {
+    for (int idx = 1; idx + 1 < argc; idx += 2) {
+        const char *value = argv[idx + 1];
+        if (!strcmp(argv[idx], "-t")) {
+            runMillis = (system_tick_t) strtoul(value, NULL, 10);
+        } else if (!strcmp(argv[idx], "-l")) {
+            loopMicros = strtoul(value, NULL, 10);
+        } else if (!strcmp(argv[idx], "-p")) {
+            unsigned long at, pin, level;
+            if (sscanf(value, "%lu,%lu,%lu", &at, &pin, &level) == 3) {
+                hostSchedulePinInput((system_tick_t) at, (pin_t) pin, (uint8_t) level);
+            }
+        } else {
+            fprintf(stderr, "usage: %s [-t millis] [-l loop micros] [-p millis,pin,level]...\n", argv[0]);
+            exit(2);
+        }
+    }
+}
+
+void setup(void);
+void loop(void);
+
+int main(int argc, char **argv) {
+    hostParseArguments(argc, argv);
+    setup();
+    while (!runMillis || nanos / 1000000 < runMillis) {
+        hostApplyScheduledInputs();
+        loop();
+        nanos += (uint64_t) loopMicros * 1000;
+    }
+    Serial.flush();
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * Controls for the host (Linux) simulation of the Photon + Internet Button that application.h is backed by.
+ *
+ * Time is simulated: it only moves when the code looks at it (each millis()/micros()/System.ticks() read moves it
+ * forward a little so busy-waits finish), when it delays, and between calls to loop().  Pin inputs can be set
+ * directly or scheduled for a simulated time, and the Internet Button's ADXL362 answers on SPI with CS on A2.
+ */
+
+#ifndef HOST_SIMULATION_H
+#define HOST_SIMULATION_H
+
+#include "application.h"
+
+#define HOST_ACCEL_CS_PIN A2
+#define HOST_ACCEL_INT1_PIN A7  // where the simulated ADXL362's INT1 output is wired (WKP, EXTI line 0 is free)
+
+/* time */
+uint64_t hostNanos(void);
+void hostAdvanceNanos(uint64_t nanos);
+
+/* pins, inputs override what the pin mode would read (pull ups read HIGH), interrupts fire on changes and, as on
+ * the Photon, attachInterrupt() fails for a pin sharing its EXTI line with one already attached (A1 and button D4) */
+void hostSetPinInput(pin_t pin, uint8_t value);
+void hostClearPinInput(pin_t pin);
+void hostSchedulePinInput(system_tick_t atMillis, pin_t pin, uint8_t value);
+void hostApplyScheduledInputs(void);
+uint8_t hostPinOutput(pin_t pin);
+unsigned int hostToneFrequency(pin_t pin);
+
+/* the simulated ADXL362, acceleration in mg (1 LSB at the default +-2g range) and temperature in LSB */
+void hostSetAcceleration(int16_t x, int16_t y, int16_t z);
+void hostSetTemperature(int16_t t);
+uint8_t hostAccelRegister(uint8_t address);
+void hostAccelSelect(bool selected);
+uint8_t hostAccelTransfer(uint8_t data);
+void hostAccelUpdate(void);  // runs activity/inactivity detection up to now, drives INT1
+
+/* main() options, -t <millis> to stop after that much simulated time, -l <micros> between loop() calls,
+ * -p <millis>,<pin>,<level> to schedule a pin input (e.g. -p 1000,4,0 -p 1100,4,1 presses button 1) */
+void hostParseArguments(int argc, char **argv);
+
+#endif //HOST_SIMULATION_H
@@ -0,0 +1,285 @@
+/*
+ * Host (Linux) simulation of the Photon: Print/Serial (stdout) and SPI with the Internet Button's ADXL362 on it.
+ */
+
+#include "HostSimulation.h"
+
+/*************************
+ * Print/Serial
+ */
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t count = 0;
+    while (size--) count += write(*buffer++);
+    return count;
+}
+
+size_t Print::print(const char *str) { return write((const uint8_t *) str, strlen(str)); }
+
+size_t Print::print(int value) { return printf("%d", value); }
+
+size_t Print::print(unsigned int value) { return printf("%u", value); }
+
+size_t Print::print(long value) { return printf("%ld", value); }
+
+size_t Print::print(unsigned long value) { return printf("%lu", value); }
+
+size_t Print::print(double value, int digits) { return printf("%.*f", digits, value); }
+
+size_t Print::println() { return print("\r\n"); }
+
+size_t Print::printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t count = vprintf(false, format, args);
+    va_end(args);
+    return count;
+}
+
+size_t Print::printlnf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t count = vprintf(true, format, args);
+    va_end(args);
+    return count;
+}
+
+size_t Print::vprintf(bool newline, const char *format, va_list args) {
+    char buffer[256];
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    if (length < 0) return 0;
+    size_t count = write((const uint8_t *) buffer, min((size_t) length, sizeof(buffer) - 1));
+    return newline ? count + println() : count;
+}
+
+size_t USBSerial::write(uint8_t b) { return fwrite(&b, 1, 1, stdout); }
+
+size_t USBSerial::write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+
+void USBSerial::flush() { fflush(stdout); }
+
+/*************************
+ * SPI
+ */
+
+void SPIClass::begin() { enabled = true; }
+
+void SPIClass::end() { enabled = false; }
+
+byte SPIClass::transfer(byte data) {
+    return index == 0 ? hostAccelTransfer(data) : 0;
+}
+
+void SPIClass::transfer(void *tx_buffer, void *rx_buffer, size_t length,
+                        wiring_spi_dma_transfercomplete_callback_t user_callback) {
+    const byte *tx = (const byte *) tx_buffer;
+    byte *rx = (byte *) rx_buffer;
+    for (size_t idx = 0; idx < length; idx++) {
+        byte value = transfer(tx ? tx[idx] : 0);
+        if (rx) rx[idx] = value;
+    }
+    // the transfer takes as long as it would on the wire, then "DMA" completes
+    if (clockSpeed) hostAdvanceNanos((uint64_t) length * 8 * 1000000000ULL / clockSpeed);
+    if (user_callback) (*user_callback)();
+}
+
+/*************************
+ * ADXL362
+ */
+
+#define ACCEL_WRITE 0x0A
+#define ACCEL_READ 0x0B
+#define ACCEL_READ_FIFO 0x0D
+#define ACCEL_FIFO_SIZE 512
+#define ACCEL_SOFT_RESET 0x1F
+#define ACCEL_REGISTERS 0x40
+
+static uint8_t accelRegisters[ACCEL_REGISTERS];
+static int16_t accelX = 0, accelY = 0, accelZ = 1000, accelT = 0;  // flat on the table
+static bool accelSelected = false;
+static int accelPhase = 0;  // 0 = command, 1 = address, 2 = data
+static uint8_t accelCommand = 0;
+static uint8_t accelAddress = 0;
+static uint16_t accelFifo[ACCEL_FIFO_SIZE];  // tagged entries, oldest first
+static int accelFifoCount = 0;
+static int accelFifoByte = 0;  // low/high byte of the entry being read
+static uint64_t accelFifoNanos = 0;  // when the next sample goes into the FIFO
+static uint64_t accelActivityNanos = 0;  // samples up to here have been checked for activity, 0 = not detecting
+static bool accelAwake = true;
+static unsigned long accelActivityCount = 0;  // consecutive samples over (activity) or within (inactivity) threshold
+static int16_t accelReference[3];
+static uint8_t accelIntLevel = LOW;
+
+static void accelReset() {
+    memset(accelRegisters, 0, sizeof(accelRegisters));
+    accelRegisters[0x00] = 0xAD;  // DEVID_AD
+    accelRegisters[0x01] = 0x1D;  // DEVID_MST
+    accelRegisters[0x02] = 0xF2;  // PARTID
+    accelRegisters[0x03] = 0x02;  // REVID
+    accelRegisters[0x2C] = 0x13;  // FILTER_CTL
+    accelFifoCount = 0;
+    accelActivityNanos = 0;
+}
+
+static void accelFifoPush(uint16_t entry) {
+    // stream mode, the oldest entries are dropped
+    if (accelFifoCount == ACCEL_FIFO_SIZE) memmove(accelFifo, accelFifo + 1, --accelFifoCount * sizeof(uint16_t));
+    accelFifo[accelFifoCount++] = entry;
+}
+
+static uint16_t accelFifoPop() {
+    if (!accelFifoCount) return 0;
+    uint16_t entry = accelFifo[0];
+    memmove(accelFifo, accelFifo + 1, --accelFifoCount * sizeof(uint16_t));
+    return entry;
+}
+
+static void accelFifoFill() {
+    // measuring with the FIFO in stream mode, a sample went in every ODR period since the last select
+    uint64_t now = hostNanos();
+    bool streaming = (accelRegisters[0x2D] & 0x03) == 0x02 && (accelRegisters[0x28] & 0x03) == 0x02;
+    uint64_t period = 80000000ULL >> (accelRegisters[0x2C] & 0x07);
+    if (!streaming || !accelFifoNanos) {
+        accelFifoNanos = now + period;
+        return;
+    }
+    int16_t values[4] = { accelX, accelY, accelZ, accelT };
+    int axes = accelRegisters[0x28] & 0x04 ? 4 : 3;
+    for (; accelFifoNanos <= now; accelFifoNanos += period) {
+        for (int idx = 0; idx < axes; idx++) accelFifoPush((uint16_t) ((idx << 14) | (values[idx] & 0x3FFF)));
+    }
+    accelRegisters[0x0C] = (uint8_t) accelFifoCount;
+    accelRegisters[0x0D] = (uint8_t) (accelFifoCount >> 8);
+}
+
+static void accelSample() {
+    int16_t values[4] = { accelX, accelY, accelZ, accelT };
+    for (int idx = 0; idx < 4; idx++) {
+        accelRegisters[0x0E + idx * 2] = (uint8_t) values[idx];
+        accelRegisters[0x0F + idx * 2] = (uint8_t) ((uint16_t) values[idx] >> 8);
+    }
+    accelRegisters[0x08] = (uint8_t) (accelX >> 4);
+    accelRegisters[0x09] = (uint8_t) (accelY >> 4);
+    accelRegisters[0x0A] = (uint8_t) (accelZ >> 4);
+    accelRegisters[0x0B] |= 0x01;  // STATUS DATA_READY
+}
+
+static bool accelBeyond(int16_t threshold, bool referenced) {
+    int16_t values[3] = { accelX, accelY, accelZ };
+    for (int idx = 0; idx < 3; idx++) {
+        if (abs(values[idx] - (referenced ? accelReference[idx] : 0)) > threshold) return true;
+    }
+    return false;
+}
+
+static void accelActivity() {
+    // activity/inactivity detection in loop mode: the sensor is awake until the samples stay within the inactivity
+    // threshold for TIME_INACT samples, then asleep until TIME_ACT samples are beyond the activity threshold
+    uint8_t control = accelRegisters[0x27];
+    bool measuring = (accelRegisters[0x2D] & 0x03) == 0x02;
+    uint64_t now = hostNanos();
+    uint64_t period = 80000000ULL >> (accelRegisters[0x2C] & 0x07);
+    if (!measuring || !(control & 0x05)) {
+        accelActivityNanos = 0;
+    } else if (!accelActivityNanos) {
+        accelActivityNanos = now;
+        accelAwake = true;
+        accelActivityCount = 0;
+        accelReference[0] = accelX; accelReference[1] = accelY; accelReference[2] = accelZ;
+    } else if (now >= accelActivityNanos + period) {
+        uint64_t samples = (now - accelActivityNanos) / period;
+        accelActivityNanos += samples * period;
+        int inactive = accelAwake ? 1 : 0;  // which detection is running
+        int16_t threshold = (int16_t) (accelRegisters[0x20 + inactive * 3] |
+                                       ((accelRegisters[0x21 + inactive * 3] & 0x07) << 8));
+        unsigned long time = inactive ? accelRegisters[0x25] | (accelRegisters[0x26] << 8) : accelRegisters[0x22];
+        bool enabled = control & (inactive ? 0x04 : 0x01);
+        bool referenced = control & (inactive ? 0x08 : 0x02);
+        if (enabled && accelBeyond(threshold, referenced) != (bool) inactive) {
+            accelActivityCount += samples;
+            if (accelActivityCount >= max(time, 1UL)) {
+                accelAwake = !accelAwake;
+                accelActivityCount = 0;
+                accelReference[0] = accelX; accelReference[1] = accelY; accelReference[2] = accelZ;
+                accelRegisters[0x0B] |= accelAwake ? 0x10 : 0x20;  // STATUS ACT / INACT
+            }
+        } else {
+            // inactivity restarts from where it moved to (so it comes to rest in a new orientation)
+            accelActivityCount = 0;
+            if (inactive) { accelReference[0] = accelX; accelReference[1] = accelY; accelReference[2] = accelZ; }
+        }
+    }
+    if (accelAwake && accelActivityNanos) accelRegisters[0x0B] |= 0x40;  // STATUS AWAKE
+    else accelRegisters[0x0B] &= ~0x40;
+    uint8_t level = (accelRegisters[0x2A] & 0x40) && accelActivityNanos && accelAwake ? HIGH : LOW;
+    if (accelRegisters[0x2A] & 0x80) level = !level;  // INT_LOW
+    if (level != accelIntLevel) {
+        accelIntLevel = level;
+        hostSetPinInput(HOST_ACCEL_INT1_PIN, level);
+    }
+}
+
+void hostAccelUpdate() { accelActivity(); }
+
+void hostSetAcceleration(int16_t x, int16_t y, int16_t z) {
+    accelX = x;
+    accelY = y;
+    accelZ = z;
+}
+
+void hostSetTemperature(int16_t t) { accelT = t; }
+
+uint8_t hostAccelRegister(uint8_t address) {
+    return address < ACCEL_REGISTERS ? accelRegisters[address] : 0;
+}
+
+void hostAccelSelect(bool selected) {
+    static bool initialized = false;
+    if (!initialized) {
+        accelReset();
+        initialized = true;
+    }
+    if (selected && !accelSelected) {
+        accelPhase = 0;
+        accelSample();  // measuring continuously, the latest sample is there to read
+        accelFifoFill();
+        accelActivity();
+        accelFifoByte = 0;
+    }
+    accelSelected = selected;
+}
+
+uint8_t hostAccelTransfer(uint8_t data) {
+    if (!accelSelected) return 0;
+    uint8_t value = 0;
+    switch (accelPhase) {
+        case 0:
+            accelCommand = data;
+            accelPhase = accelCommand == ACCEL_READ_FIFO ? 2 : 1;  // no address for the FIFO
+            break;
+        case 1:
+            accelAddress = data;
+            accelPhase = 2;
+            break;
+        default:
+            if (accelCommand == ACCEL_READ_FIFO) {
+                // little endian entries, the entry leaves the FIFO once both bytes are read
+                static uint16_t entry = 0;
+                if (!accelFifoByte) entry = accelFifoPop();
+                value = (uint8_t) (accelFifoByte ? entry >> 8 : entry);
+                accelFifoByte ^= 1;
+                accelRegisters[0x0C] = (uint8_t) accelFifoCount;
+                accelRegisters[0x0D] = (uint8_t) (accelFifoCount >> 8);
+                break;
+            } else if (accelCommand == ACCEL_READ) {
+                value = hostAccelRegister(accelAddress);
+                if (accelAddress == 0x0B) accelRegisters[0x0B] &= ~0x31;  // DATA_READY, ACT and INACT clear on read
+            } else if (accelCommand == ACCEL_WRITE) {
+                if (accelAddress == ACCEL_SOFT_RESET && data == 0x52) accelReset();
+                else if (accelAddress >= 0x1F && accelAddress < ACCEL_REGISTERS) accelRegisters[accelAddress] = data;
+            }
+            accelAddress++;
+            break;
+    }
+    return value;
+}
@@ -0,0 +1,206 @@
+/*
+ * Host (Linux) stand-in for Particle's application.h, enough of the wiring API to build and run
+ * BetterPhotonButton and its examples off-device.  See HostSimulation.h for the simulation controls.
+ */
+
+#ifndef HOST_APPLICATION_H
+#define HOST_APPLICATION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <type_traits>
+
+#define PLATFORM_ID 3  // Particle's "gcc" virtual device
+
+typedef uint8_t byte;
+typedef uint16_t pin_t;
+typedef uint32_t system_tick_t;
+
+enum PinMode { INPUT, OUTPUT, INPUT_PULLUP, INPUT_PULLDOWN };
+enum InterruptMode { CHANGE, RISING, FALLING };
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define D0 0
+#define D1 1
+#define D2 2
+#define D3 3
+#define D4 4
+#define D5 5
+#define D6 6
+#define D7 7
+#define A0 10
+#define A1 11
+#define A2 12
+#define A3 13
+#define A4 14
+#define A5 15
+#define A6 16
+#define A7 17
+#define RX 18
+#define TX 19
+#define TOTAL_PINS 24
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x01
+#define SPI_MODE2 0x02
+#define SPI_MODE3 0x03
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define MHZ 1000000
+
+#define SYSTEM_THREAD(state)
+#define SYSTEM_MODE(mode)
+#define SINGLE_THREADED_BLOCK()
+#define ATOMIC_BLOCK()
+
+#define arraySize(a) (sizeof((a))/sizeof((a[0])))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+template <typename T, typename U>
+inline typename std::common_type<T, U>::type min(T a, U b) { return a < b ? a : b; }
+template <typename T, typename U>
+inline typename std::common_type<T, U>::type max(T a, U b) { return a > b ? a : b; }
+
+inline bool isDigit(int c) { return c >= '0' && c <= '9'; }
+
+/* time (simulated, see HostSimulation.h) */
+system_tick_t millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/* gpio */
+void pinMode(pin_t pin, PinMode mode);
+void digitalWrite(pin_t pin, uint8_t value);
+int32_t digitalRead(pin_t pin);
+void tone(pin_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(pin_t pin);
+
+typedef void (*wiring_interrupt_handler_t)(void);
+bool attachInterrupt(pin_t pin, wiring_interrupt_handler_t handler, InterruptMode mode);
+void detachInterrupt(pin_t pin);
+void interrupts(void);
+void noInterrupts(void);
+
+inline void __disable_irq(void) { }
+inline void __enable_irq(void) { }
+
+/* random */
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned int seed);
+
+/* String */
+class String {
+public:
+    String() { }
+    String(const char *cstr) : value(cstr ? cstr : "") { }
+    String(const String &other) : value(other.value) { }
+    String(int number) : value(std::to_string(number)) { }
+
+    String &operator = (const String &other) { value = other.value; return *this; }
+    String &operator = (const char *cstr) { value = cstr ? cstr : ""; return *this; }
+    String &operator += (const String &other) { value += other.value; return *this; }
+    bool operator == (const String &other) const { return value == other.value; }
+
+    const char *c_str() const { return value.c_str(); }
+    unsigned int length() const { return (unsigned int) value.length(); }
+    char charAt(unsigned int index) const { return index < value.length() ? value[index] : 0; }
+
+private:
+    std::string value;
+};
+
+/* Print/Stream/Serial */
+class Print {
+public:
+    virtual ~Print() { }
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    virtual int availableForWrite() { return 0x7FFF; }
+
+    size_t print(const char *str);
+    size_t print(const String &str) { return print(str.c_str()); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(int value);
+    size_t print(unsigned int value);
+    size_t print(long value);
+    size_t print(unsigned long value);
+    size_t print(double value, int digits = 2);
+    size_t println();
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    size_t printlnf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+private:
+    size_t vprintf(bool newline, const char *format, va_list args);
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+};
+
+class USBSerial : public Stream {
+public:
+    void begin(long baud = 9600) { (void) baud; }
+    void end() { }
+    bool isConnected() { return true; }
+    virtual size_t write(uint8_t b) override;
+    virtual size_t write(const uint8_t *buffer, size_t size) override;
+    virtual int available() override { return 0; }
+    virtual int read() override { return -1; }
+    virtual int peek() override { return -1; }
+    virtual void flush() override;
+    operator bool() { return true; }
+};
+
+extern USBSerial Serial;
+
+/* SPI */
+typedef void (*wiring_spi_dma_transfercomplete_callback_t)(void);
+
+class SPIClass {
+public:
+    SPIClass(int index) : index(index) { }
+    void begin();
+    void begin(uint16_t ss) { (void) ss; begin(); }
+    void end();
+    void setBitOrder(uint8_t order) { (void) order; }
+    void setDataMode(uint8_t mode) { (void) mode; }
+    void setClockDivider(uint8_t divider) { (void) divider; }
+    unsigned setClockSpeed(unsigned value, unsigned scale = 1) { clockSpeed = value * scale; return clockSpeed; }
+    byte transfer(byte data);
+    void transfer(void *tx_buffer, void *rx_buffer, size_t length, wiring_spi_dma_transfercomplete_callback_t user_callback);
+    void transferCancel() { }
+    bool isEnabled() { return enabled; }
+
+    int index;
+    unsigned clockSpeed = 0;
+    bool enabled = false;
+};
+
+extern SPIClass SPI;
+extern SPIClass SPI1;
+
+/* System */
+class SystemClass {
+public:
+    static uint32_t ticks();
+    static uint32_t ticksPerMicrosecond() { return 120; }
+};
+
+extern SystemClass System;
+
+#endif //HOST_APPLICATION_H
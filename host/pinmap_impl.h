@@ -0,0 +1,30 @@
+/*
+ * Host stand-in for the Photon HAL pin map, each pin points at a simulated GPIO port so the
+ * WS2812 bit-bang code can write its set/reset registers.
+ */
+
+#ifndef HOST_PINMAP_IMPL_H
+#define HOST_PINMAP_IMPL_H
+
+#include "application.h"
+
+typedef struct {
+    volatile uint32_t MODER;
+    volatile uint32_t OTYPER;
+    volatile uint32_t OSPEEDR;
+    volatile uint32_t PUPDR;
+    volatile uint32_t IDR;
+    volatile uint32_t ODR;
+    volatile uint16_t BSRRL;
+    volatile uint16_t BSRRH;
+} GPIO_TypeDef;
+
+typedef struct STM32_Pin_Info {
+    GPIO_TypeDef *gpio_peripheral;
+    pin_t gpio_pin;
+    uint8_t gpio_pin_source;
+} STM32_Pin_Info;
+
+STM32_Pin_Info *HAL_Pin_Map(void);
+
+#endif //HOST_PINMAP_IMPL_H
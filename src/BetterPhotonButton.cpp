@@ -17,23 +17,91 @@ limitations under the License.
 #include "BetterPhotonButton.h"
 #include <math.h>
 #include "pinmap_impl.h"
+#include <algorithm>
+#include <atomic>
 
 /*************************
  * BetterPhotonButton
  */
 
 byte buttonPins[BUTTON_COUNT] = {BUTTON_1_PHOTON_PIN, BUTTON_2_PHOTON_PIN, BUTTON_3_PHOTON_PIN, BUTTON_4_PHOTON_PIN};
-bool buttonState[BUTTON_COUNT] = {0};
-bool buttonPrevState[BUTTON_COUNT] = {0};
-int buttonPrevUpdate[BUTTON_COUNT] = {0};
+volatile uint32_t *buttonInputs[BUTTON_COUNT] = {0};  // the pins' port input registers, resolved in setup()
+uint16_t buttonInputMasks[BUTTON_COUNT] = {0};
+ButtonDebouncer buttonDebouncer = ButtonDebouncer();
+uint32_t buttonLevels = 0;  // raw levels, bit per button, 1 = pressed
+system_tick_t buttonSampled = 0;
+unsigned long buttonLevelMicros[BUTTON_COUNT] = {0};  // when each raw level last changed
+unsigned long buttonEdgeMicros[BUTTON_COUNT] = {0};
+ButtonGestures buttonGestures = ButtonGestures();
+
+static_assert(BUTTON_COUNT <= 32, "buttons are debounced as bits of a 32 bit word");
+
+// button edges from the pin interrupts, only the interrupts move the head and only update() moves the tail (the
+// button interrupts share a priority so they never preempt each other, which keeps it single producer)
+struct ButtonEvent {
+    unsigned long micros;
+    byte button;
+    bool pressed;
+};
+ButtonEvent buttonQueue[BUTTON_QUEUE_SIZE];
+volatile byte buttonQueueHead = 0;
+volatile byte buttonQueueTail = 0;
+volatile bool buttonQueueOverflow = false;
+
+static_assert((BUTTON_QUEUE_SIZE & (BUTTON_QUEUE_SIZE - 1)) == 0 && BUTTON_QUEUE_SIZE <= 128, "BUTTON_QUEUE_SIZE");
+
+template<byte button>
+void buttonInterrupt() {
+    byte head = buttonQueueHead;
+    if ((byte) (head - buttonQueueTail) >= BUTTON_QUEUE_SIZE) {
+        buttonQueueOverflow = true;  // update() resyncs from the pins
+        return;
+    }
+    ButtonEvent &event = buttonQueue[head & (BUTTON_QUEUE_SIZE - 1)];
+    event.micros = micros();
+    event.button = button;
+    event.pressed = !digitalRead(buttonPins[button]);
+    std::atomic_signal_fence(std::memory_order_release);  // the event is written before it is published
+    buttonQueueHead = head + 1;
+}
+
+wiring_interrupt_handler_t buttonInterruptHandlers[BUTTON_COUNT] = {
+        &buttonInterrupt<0>, &buttonInterrupt<1>, &buttonInterrupt<2>, &buttonInterrupt<3>
+};
 
 ButtonHandler *buttonPressed[BUTTON_COUNT] = {0};
 ButtonHandler *buttonReleased[BUTTON_COUNT] = {0};
 
-PixelColor pixels[PIXEL_COUNT] = {0};
-PhotonWS2812Pixel pixelRing = PhotonWS2812Pixel(pixels, PIXEL_COUNT, PIXEL_PHOTON_PIN);
+PixelColor pixels[PIXEL_COUNT] = {0};  // set directly or by the main animation
+PixelColor layerPixels[PIXEL_LAYER_COUNT][PIXEL_COUNT] = {{0}};
+PhotonWS2812Strip<PIXEL_COUNT, PIXEL_PHOTON_PIN> pixelRing;  // pixels with the layers composited on top
 PhotonADXL362Accel accelerometer = PhotonADXL362Accel(ADXL_PHOTON_PIN);
 
+// milliseconds from now until deadline, 0 if it has passed (safe across millis() wrapping)
+inline system_tick_t timeUntil(system_tick_t deadline, system_tick_t now) {
+    return (int32_t) (deadline - now) > 0 ? deadline - now : 0;
+}
+
+#ifdef BETTERPHOTONBUTTON_PROFILE
+const char *profileStageNames[PROFILE_STAGES] = {
+        "notes", "animation", "layers", "compose", "pixels", "accel", "buttons", "update", "interval"
+};
+
+inline uint32_t ticksToNanos(uint32_t ticks) {
+    return (uint32_t) ((uint64_t) ticks * 1000 / System.ticksPerMicrosecond());
+}
+
+#define PROFILE_START() uint32_t profileStart = System.ticks(), profileTicks = profileStart; \
+    if (profileLastUpdate) profile[PROFILE_INTERVAL].record(ticksToNanos(profileStart - profileLastUpdate)); \
+    profileLastUpdate = profileStart
+#define PROFILE_STAGE(stage) profileTicks = profileRecord(stage, profileTicks)
+#define PROFILE_END() profile[PROFILE_UPDATE].record(ticksToNanos(System.ticks() - profileStart))
+#else
+#define PROFILE_START()
+#define PROFILE_STAGE(stage)
+#define PROFILE_END()
+#endif
+
 /*
  * constructors/destructors
  */
@@ -41,6 +109,15 @@ PhotonADXL362Accel accelerometer = PhotonADXL362Accel(ADXL_PHOTON_PIN);
 BetterPhotonButton::BetterPhotonButton() {
     animationData.pixels = pixels;
     animationData.pixelCount = PIXEL_COUNT;
+    for (int idx = 0; idx < PIXEL_LAYER_COUNT; idx++) {
+        layers[idx].data.pixels = layerPixels[idx];
+        layers[idx].data.pixelCount = PIXEL_COUNT;
+    }
+    pixelsChanged = true;
+    buttonInterrupts = false;
+#ifdef BETTERPHOTONBUTTON_PROFILE
+    resetProfile();
+#endif
 }
 
 
@@ -50,26 +127,88 @@ BetterPhotonButton::BetterPhotonButton() {
 
 void BetterPhotonButton::setup(void) {
     pixelRing.setup();
+    STM32_Pin_Info *pinMap = HAL_Pin_Map();
     for (int idx = 0; idx < BUTTON_COUNT; idx++) {
         pinMode(buttonPins[idx], INPUT_PULLUP);
+        buttonInputs[idx] = &pinMap[buttonPins[idx]].gpio_peripheral->IDR;
+        buttonInputMasks[idx] = pinMap[buttonPins[idx]].gpio_pin;
     }
 }
 
-void BetterPhotonButton::update(system_tick_t millis) {
+system_tick_t BetterPhotonButton::update(system_tick_t millis) {
+    PROFILE_START();
     updatePlayNotes(millis);
+    PROFILE_STAGE(PROFILE_NOTES);
     updateAnimation(millis);
+    PROFILE_STAGE(PROFILE_ANIMATION);
+    updateLayers(millis);
+    PROFILE_STAGE(PROFILE_LAYERS);
+    if (pixelsChanged) { composePixels(); }
+    PROFILE_STAGE(PROFILE_COMPOSE);
     pixelRing.update();
+    PROFILE_STAGE(PROFILE_PIXELS);
     accelerometer.update(millis);
+    PROFILE_STAGE(PROFILE_ACCEL);
     updateButtonsState(millis);
+    buttonGestures.update(millis);
+    PROFILE_STAGE(PROFILE_BUTTONS);
+    PROFILE_END();
+    return nextDeadline(millis);
+}
+
+system_tick_t BetterPhotonButton::nextDeadline(system_tick_t millis) {
+    if (pixelsChanged || pixelRing.isTransmitting() || buttonQueueHead != buttonQueueTail) return 0;
+    // polled buttons are sampled continuously, with interrupts only while one is settling
+    bool settling = buttonDebouncer.pending() || buttonLevels != buttonDebouncer.state;
+    system_tick_t wait = buttonInterrupts && !settling ? DEADLINE_NONE :
+                         timeUntil(buttonSampled + BUTTON_SAMPLE_TIME, millis);
+    if (animationFunction) {
+        wait = min(wait, timeUntil(animationData.updated + animationRefresh + 1, millis));
+        if (animationData.stop > animationData.start) wait = min(wait, timeUntil(animationData.stop + 1, millis));
+    }
+    for (byte idx = 0; idx < PIXEL_LAYER_COUNT; idx++) {
+        PixelLayer *layer = &layers[idx];
+        if (layer->animation) wait = min(wait, timeUntil(layer->data.updated + layer->refresh + 1, millis));
+    }
+    if (noteCurrent) wait = min(wait, timeUntil(noteNextUpdate, millis));
+    system_tick_t gestureDeadline = buttonGestures.nextDeadline();
+    if (gestureDeadline != DEADLINE_NONE) wait = min(wait, timeUntil(gestureDeadline, millis));
+    system_tick_t accelDeadline = accelerometer.nextDeadline();
+    if (accelDeadline != DEADLINE_NONE) wait = min(wait, timeUntil(accelDeadline, millis));
+    return wait;
 }
 
 bool BetterPhotonButton::isButtonPressed(byte button) {
-    return button < BUTTON_COUNT ? buttonState[button] : false;
+    return button < BUTTON_COUNT ? (buttonDebouncer.state >> button) & 1 : false;
 }
 
 bool BetterPhotonButton::allButtonsPressed() {
-    for (int idx = 0; idx < BUTTON_COUNT; idx++) { if (!buttonState[idx]) return false; }
-    return true;
+    return buttonDebouncer.state == (uint32_t) ((1ULL << BUTTON_COUNT) - 1);
+}
+
+void BetterPhotonButton::setButtonInterrupts(bool enabled) {
+    for (byte idx = 0; idx < BUTTON_COUNT; idx++) {
+        if (enabled) attachInterrupt(buttonPins[idx], buttonInterruptHandlers[idx], CHANGE);
+        else detachInterrupt(buttonPins[idx]);
+    }
+    if (enabled && !buttonInterrupts) {
+        // start from the current levels, edges from here on come from the queue
+        buttonQueueTail = buttonQueueHead;
+        setButtonLevels(readButtons(), micros());
+    }
+    this->buttonInterrupts = enabled;
+}
+
+unsigned long BetterPhotonButton::getButtonMicros(byte button) {
+    return button < BUTTON_COUNT ? buttonEdgeMicros[button] : 0;
+}
+
+void BetterPhotonButton::setGestureHandler(GestureHandler *handler) {
+    buttonGestures.setHandler(handler);
+}
+
+void BetterPhotonButton::setGestureTiming(unsigned int longPress, unsigned int doubleClick, unsigned int repeat) {
+    buttonGestures.setTiming(longPress, doubleClick, repeat);
 }
 
 void BetterPhotonButton::setPressedHandler(ButtonHandler *handler) {
@@ -98,7 +237,8 @@ void BetterPhotonButton::setPixel(int pixel, byte r, byte g, byte b) {
 
 void BetterPhotonButton::setPixel(int pixel, PixelColor color) {
     animationFunction = NULL;
-    pixelRing.setPixelColor(pixel, color);
+    if (pixel >= 0 && pixel < PIXEL_COUNT) { pixels[pixel] = color; }
+    pixelsChanged = true;
 };
 
 void BetterPhotonButton::setPixels(byte r, byte g, byte b) {
@@ -107,26 +247,31 @@ void BetterPhotonButton::setPixels(byte r, byte g, byte b) {
 
 void BetterPhotonButton::setPixels(PixelColor color) {
     animationFunction = NULL;
-    for (int idx = 0; idx < PIXEL_COUNT; idx++) { pixelRing.setPixelColor(idx, color); }
+    for (int idx = 0; idx < PIXEL_COUNT; idx++) { pixels[idx] = color; }
+    pixelsChanged = true;
 };
 
 void BetterPhotonButton::setPixels(PixelColor* colors, int count) {
     animationFunction = NULL;
-    for (int idx = 0; idx < PIXEL_COUNT; idx++) { pixelRing.setPixelColor(idx, idx < count ? colors[idx] : 0); }
+    for (int idx = 0; idx < PIXEL_COUNT; idx++) { pixels[idx] = idx < count ? colors[idx] : 0; }
+    pixelsChanged = true;
 }
 
 void BetterPhotonButton::updatePixel(int pixel, PixelColor color) {
-    pixelRing.setPixelColor(pixel, color);
+    if (pixel >= 0 && pixel < PIXEL_COUNT) { pixels[pixel] = color; }
+    composePixels();
     pixelRing.update(true);
 };
 
 void BetterPhotonButton::updatePixels(PixelColor color) {
-    for (int idx = 0; idx < PIXEL_COUNT; idx++) { pixelRing.setPixelColor(idx, color); }
+    for (int idx = 0; idx < PIXEL_COUNT; idx++) { pixels[idx] = color; }
+    composePixels();
     pixelRing.update(true);
 };
 
 void BetterPhotonButton::updatePixels(PixelColor* colors, int count) {
-    for (int idx = 0; idx < PIXEL_COUNT; idx++) { pixelRing.setPixelColor(idx, idx < count ? colors[idx] : 0); }
+    for (int idx = 0; idx < PIXEL_COUNT; idx++) { pixels[idx] = idx < count ? colors[idx] : 0; }
+    composePixels();
     pixelRing.update(true);
 }
 
@@ -134,6 +279,18 @@ PixelColor BetterPhotonButton::getPixel(int pixel) {
     return pixels[pixel];
 }
 
+void BetterPhotonButton::setBrightness(byte brightness) {
+    pixelRing.setBrightness(brightness);
+}
+
+void BetterPhotonButton::setGamma(bool gamma) {
+    pixelRing.setGamma(gamma);
+}
+
+PhotonWS2812Pixel* BetterPhotonButton::getPixelRing() {
+    return &pixelRing;
+}
+
 PixelAnimationData* BetterPhotonButton::startPixelAnimation(PixelAnimation *animation, PixelPalette *palette,
                                                             long cycle, long duration, int refresh) {
     animationFunction = animation;
@@ -154,8 +311,38 @@ void BetterPhotonButton::rainbow(long cycle, long duration) {
     startPixelAnimation(&animation_gradient, &paletteRainbow, cycle, duration);
 }
 
-PhotonADXL362Accel* BetterPhotonButton::startAccelerometer(unsigned int refreshRate) {
-    accelerometer.setup(refreshRate);
+PixelAnimationData* BetterPhotonButton::startPixelLayer(byte layer, PixelAnimation *animation,
+                                                        PixelLayer::Blend blend, byte alpha, PixelPalette *palette,
+                                                        long cycle, long duration, int refresh) {
+    if (layer >= PIXEL_LAYER_COUNT) return NULL;
+    PixelLayer *pixelLayer = &layers[layer];
+    std::fill(layerPixels[layer], layerPixels[layer] + PIXEL_COUNT, PixelColor(0));
+    pixelLayer->animation = animation;
+    pixelLayer->blend = blend;
+    pixelLayer->alpha = alpha;
+    pixelLayer->refresh = refresh;
+    pixelLayer->data.palette = palette;
+    pixelLayer->data.cycleMillis = cycle;
+    pixelLayer->data.start = millis();
+    pixelLayer->data.stop = pixelLayer->data.start + duration;
+    pixelLayer->data.updated = 0;
+    pixelLayer->data.temp = 0;
+    return &pixelLayer->data;
+}
+
+void BetterPhotonButton::stopPixelLayer(byte layer) {
+    if (layer < PIXEL_LAYER_COUNT) {
+        layers[layer].animation = NULL;
+        pixelsChanged = true;
+    }
+}
+
+bool BetterPhotonButton::isPixelLayerActive(byte layer) {
+    return layer < PIXEL_LAYER_COUNT && layers[layer].animation;
+}
+
+PhotonADXL362Accel* BetterPhotonButton::startAccelerometer(unsigned int refreshRate, AccelFilter *filter) {
+    accelerometer.setup(refreshRate, filter);
     return &accelerometer;
 }
 
@@ -204,27 +391,104 @@ void BetterPhotonButton::stopPlayingNotes() {
 }
 
 
+#ifdef BETTERPHOTONBUTTON_PROFILE
+const ProfileStage *BetterPhotonButton::getProfile(ProfileStageId stage) {
+    return stage < PROFILE_STAGES ? &profile[stage] : NULL;
+}
+
+void BetterPhotonButton::resetProfile() {
+    memset(profile, 0, sizeof(profile));
+    profileLastUpdate = 0;
+}
+
+void BetterPhotonButton::printProfile(Print &out) {
+    out.print("stage,count,mean_ns,min_ns,max_ns");
+    for (int bin = 0; bin < PROFILE_HISTOGRAM_BINS; bin++) {
+        if (bin < PROFILE_HISTOGRAM_BINS - 1) out.printf(",lt%luus", 1UL << (2 * bin));
+        else out.printf(",ge%luus", 1UL << (2 * (bin - 1)));
+    }
+    out.println();
+    for (int stage = 0; stage < PROFILE_STAGES; stage++) {
+        ProfileStage &timing = profile[stage];
+        out.printf("%s,%lu,%lu,%lu,%lu", profileStageNames[stage], timing.count, (unsigned long) timing.mean(),
+                   (unsigned long) timing.min, (unsigned long) timing.max);
+        for (int bin = 0; bin < PROFILE_HISTOGRAM_BINS; bin++) {
+            out.printf(",%lu", timing.histogram[bin]);
+        }
+        out.println();
+    }
+}
+#endif
+
 /*
  * private helpers
  */
 
+#ifdef BETTERPHOTONBUTTON_PROFILE
+uint32_t BetterPhotonButton::profileRecord(ProfileStageId stage, uint32_t since) {
+    profile[stage].record(ticksToNanos(System.ticks() - since));
+    return System.ticks();  // the next stage starts after the bookkeeping
+}
+#endif
+
 void BetterPhotonButton::updateButtonsState(system_tick_t millis) {
-    for (byte idx = 0; idx < BUTTON_COUNT; idx++) { updateButtonState(idx, millis); }
+    // with interrupts the levels are kept up to date from the queued edges, otherwise read when sampled
+    if (buttonInterrupts) updateButtonEvents();
+    if (millis - buttonSampled < BUTTON_SAMPLE_TIME) return;
+    buttonSampled = millis;
+    if (!buttonInterrupts) setButtonLevels(readButtons(), micros());
+    uint32_t changed = buttonDebouncer.sample(buttonLevels);
+    while (changed) {
+        byte button = (byte) __builtin_ctz(changed);
+        changed &= changed - 1;
+        bool pressed = (buttonDebouncer.state >> button) & 1;
+        buttonEdgeMicros[button] = buttonLevelMicros[button];
+        // call the pressed or released handler function if one has been set for this button
+        ButtonHandler *handler = pressed ? buttonPressed[button] : buttonReleased[button];
+        if (handler) { (*handler)((int)button, pressed); }
+        buttonGestures.edge(button, pressed, millis, buttonEdgeMicros[button]);
+    }
 }
 
-void BetterPhotonButton::updateButtonState(byte button, system_tick_t millis) {
-    bool currentState = (bool) !digitalRead(buttonPins[button]);
-    if (currentState != buttonPrevState[button]) {
-        buttonPrevState[button] = currentState;
-        buttonPrevUpdate[button] = millis;
+void BetterPhotonButton::updateButtonEvents() {
+    if (buttonQueueOverflow) {
+        // edges were dropped, start over from what the pins say now
+        buttonQueueTail = buttonQueueHead;
+        buttonQueueOverflow = false;
+        setButtonLevels(readButtons(), micros());
+        return;
     }
-    if ((millis - buttonPrevUpdate[button] > BUTTON_DEBOUNCE_DELAY) &&
-        (currentState == buttonPrevState[button]) &&
-        (currentState != buttonState[button])) {
-        buttonState[button] = currentState;
-        // call the pressed or released handler function if one has been set for this button
-        ButtonHandler *handler = currentState ? buttonPressed[button] : buttonReleased[button];
-        if (handler) { (*handler)((int)button, currentState); }
+    byte tail = buttonQueueTail;
+    while (tail != buttonQueueHead) {
+        std::atomic_signal_fence(std::memory_order_acquire);
+        const ButtonEvent &event = buttonQueue[tail & (BUTTON_QUEUE_SIZE - 1)];
+        uint32_t bit = 1UL << event.button;
+        setButtonLevels(event.pressed ? buttonLevels | bit : buttonLevels & ~bit, event.micros);
+        buttonQueueTail = ++tail;
+    }
+}
+
+uint32_t BetterPhotonButton::readButtons() {
+    // each port's input register is read once, buttons on the same port are next to each other in buttonPins
+    uint32_t pressed = 0;
+    volatile uint32_t *input = NULL;
+    uint32_t levels = 0;
+    for (byte idx = 0; idx < BUTTON_COUNT; idx++) {
+        if (buttonInputs[idx] != input) {
+            input = buttonInputs[idx];
+            levels = *input;
+        }
+        if (!(levels & buttonInputMasks[idx])) pressed |= 1UL << idx;  // pulled up, pressed = low
+    }
+    return pressed;
+}
+
+void BetterPhotonButton::setButtonLevels(uint32_t levels, unsigned long micros) {
+    uint32_t changed = levels ^ buttonLevels;
+    buttonLevels = levels;
+    while (changed) {
+        buttonLevelMicros[__builtin_ctz(changed)] = micros;
+        changed &= changed - 1;
     }
 }
 
@@ -236,11 +500,37 @@ void BetterPhotonButton::updateAnimation(system_tick_t millis) {
         else {
             animationData.updated = millis;
             animationFunction(&animationData);
-            pixelRing.triggerRefresh();
+            pixelsChanged = true;
         }
     }
 }
 
+void BetterPhotonButton::updateLayers(system_tick_t millis) {
+    for (byte idx = 0; idx < PIXEL_LAYER_COUNT; idx++) {
+        PixelLayer *layer = &layers[idx];
+        if (layer->animation && (millis > layer->data.updated + layer->refresh)) {
+            if (layer->data.stop > layer->data.start && millis > layer->data.stop) {
+                layer->animation = NULL;
+            }
+            else {
+                layer->data.updated = millis;
+                layer->animation(&layer->data);
+            }
+            pixelsChanged = true;
+        }
+    }
+}
+
+void BetterPhotonButton::composePixels() {
+    memcpy(pixelRing.pixels, pixels, sizeof(pixels));
+    for (byte idx = 0; idx < PIXEL_LAYER_COUNT; idx++) {
+        PixelLayer *layer = &layers[idx];
+        if (layer->animation) { pixelBlend(pixelRing.pixels, layer->data.pixels, PIXEL_COUNT, layer->blend, layer->alpha); }
+    }
+    pixelsChanged = false;
+    pixelRing.triggerRefresh();
+}
+
 void BetterPhotonButton::updatePlayNotes(system_tick_t millis) {
     if (noteCurrent && (millis >= noteNextUpdate)) {
         if (*noteCurrent == ':') {
@@ -286,24 +576,247 @@ void BetterPhotonButton::changeNoteSettings(char *current) {
 
 
 
+/*************************
+ * ButtonGestures
+ */
+
+#define GESTURE_NONE -1
+
+// what each input does in each state (a chord takes its buttons to CHORDED outside the table)
+const ButtonGestures::Transition ButtonGestures::transitions[STATES][INPUTS] = {
+        /*              PRESS                     RELEASE                                  TIMEOUT */
+        /* IDLE */     {{DOWN, GESTURE_NONE},        {IDLE, GESTURE_NONE},                  {IDLE, GESTURE_NONE}},
+        /* DOWN */     {{DOWN, GESTURE_NONE},        {CLICKED, GESTURE_NONE},               {HELD, GESTURE_LONG_PRESS}},
+        /* HELD */     {{HELD, GESTURE_NONE},        {IDLE, GESTURE_NONE},                  {HELD, GESTURE_REPEAT}},
+        /* CLICKED */  {{DOWN_AGAIN, GESTURE_NONE},  {CLICKED, GESTURE_NONE},               {IDLE, GESTURE_CLICK}},
+        /* DOWN_AGAIN */{{DOWN_AGAIN, GESTURE_NONE}, {IDLE, GESTURE_DOUBLE_CLICK},          {HELD, GESTURE_LONG_PRESS}},
+        /* CHORDED */  {{CHORDED, GESTURE_NONE},     {IDLE, GESTURE_NONE},                  {CHORDED, GESTURE_NONE}},
+};
+
+/*
+ * constructors/destructors
+ */
+
+ButtonGestures::ButtonGestures() {
+    memset(buttons, 0, sizeof(buttons));
+    down = 0;
+    timed = 0;
+    longPress = BUTTON_LONG_PRESS;
+    doubleClick = BUTTON_DOUBLE_CLICK;
+    repeat = BUTTON_REPEAT;
+    handler = NULL;
+}
+
+/*
+ * public api
+ */
+
+void ButtonGestures::setHandler(GestureHandler *handler) {
+    this->handler = handler;
+}
+
+void ButtonGestures::setTiming(unsigned int longPress, unsigned int doubleClick, unsigned int repeat) {
+    this->longPress = longPress;
+    this->doubleClick = doubleClick;
+    this->repeat = repeat;
+}
+
+void ButtonGestures::edge(byte button, bool pressed, system_tick_t millis, unsigned long micros) {
+    if (button >= GESTURE_MAX_BUTTONS) return;
+    uint32_t bit = 1UL << button;
+    if (!pressed) {
+        down &= ~bit;
+        input(button, RELEASE, millis);
+        return;
+    }
+    down |= bit;
+    if (buttons[button].state == IDLE) {
+        buttons[button].pressed = millis;
+        buttons[button].micros = micros;
+        buttons[button].repeats = 0;
+    }
+    if (down & (down - 1)) {
+        // more than one button held, they're a chord now rather than separate clicks
+        for (uint32_t held = down; held; held &= held - 1) {
+            Button &chorded = buttons[__builtin_ctz(held)];
+            chorded.state = CHORDED;
+        }
+        timed &= ~down;
+        report(GESTURE_CHORD, button, down, millis);
+        return;
+    }
+    input(button, PRESS, millis);
+}
+
+void ButtonGestures::update(system_tick_t millis) {
+    for (uint32_t pending = timed; pending; pending &= pending - 1) {
+        byte button = (byte) __builtin_ctz(pending);
+        if ((int32_t) (millis - buttons[button].deadline) >= 0) input(button, TIMEOUT, millis);
+    }
+}
+
+system_tick_t ButtonGestures::nextDeadline() {
+    system_tick_t deadline = DEADLINE_NONE;
+    for (uint32_t pending = timed; pending; pending &= pending - 1) {
+        deadline = min(deadline, buttons[__builtin_ctz(pending)].deadline);
+    }
+    return deadline;
+}
+
+/*
+ * private helpers
+ */
+
+void ButtonGestures::input(byte button, Input input, system_tick_t millis) {
+    Button &state = buttons[button];
+    const Transition &transition = transitions[state.state][input];
+    if (transition.next != state.state || input == TIMEOUT) {
+        int32_t wait = timeout(transition.next);
+        if (wait < 0) timed &= ~(1UL << button);
+        else {
+            state.deadline = (input == TIMEOUT ? state.deadline : millis) + wait;
+            timed |= 1UL << button;
+        }
+    }
+    state.state = transition.next;
+    if (transition.gesture != GESTURE_NONE) {
+        if (transition.gesture == GESTURE_REPEAT) state.repeats++;
+        report((GestureType) transition.gesture, button, 1UL << button, millis);
+    }
+    // a click with double clicks off is reported right away
+    if (state.state == CLICKED && !doubleClick) this->input(button, TIMEOUT, millis);
+}
+
+int32_t ButtonGestures::timeout(State state) {
+    switch (state) {
+        case DOWN: case DOWN_AGAIN: return longPress ? (int32_t) longPress : -1;
+        case HELD: return repeat ? (int32_t) repeat : -1;
+        case CLICKED: return doubleClick;
+        default: return -1;
+    }
+}
+
+void ButtonGestures::report(GestureType type, byte button, uint32_t buttons, system_tick_t millis) {
+    if (!handler) return;
+    ButtonGesture gesture;
+    gesture.type = type;
+    gesture.button = button;
+    gesture.buttons = buttons;
+    gesture.repeats = this->buttons[button].repeats;
+    gesture.held = millis - this->buttons[button].pressed;
+    gesture.micros = this->buttons[button].micros;
+    (*handler)(&gesture);
+}
+
+
+
 /*************************
  * PhotonWS2812Pixel
  */
 
-STM32_Pin_Info* BB_PIN_MAP = HAL_Pin_Map(); // Pointer required for highest access speed
-#define bbPinLO(_pin) (BB_PIN_MAP[_pin].gpio_peripheral->BSRRH = BB_PIN_MAP[_pin].gpio_pin)
-#define bbPinHI(_pin) (BB_PIN_MAP[_pin].gpio_peripheral->BSRRL = BB_PIN_MAP[_pin].gpio_pin)
+STM32_Pin_Info* BB_PIN_MAP = HAL_Pin_Map(); // only used to resolve a pin's registers once, not per bit
+#define bbPinLO() (*resetRegister = pinBit)  // sendFrame()'s registers, constants for a PhotonWS2812Strip
+#define bbPinHI() (*setRegister = pinBit)
+#if defined(__arm__)
+#define bbDelay(nops) asm volatile(nops ::: "r0", "cc", "memory")
+#else
+#define bbDelay(nops) asm volatile("" ::: "memory")  // host build, no timing to keep
+#endif
 #define PIXEL_WAIT_TIME 50L
+#define PIXEL_NO_PIN 0xFF  // matches no Photon pin
+#define PIXEL_BITBANG_TIME 30  // microseconds to bit-bang one pixel
+#define PIXEL_CHUNK_MAX_GAP 20  // microseconds of low between chunks that are safely short of a latch
+#define PIXEL_CHUNK_RESTARTS 3  // restarts for overlong gaps before the frame is deferred to the next update()
+
+// a WS2812 bit as 4 SPI bits at PIXEL_SPI_CLOCK: 0 = 1000 (267ns high), 1 = 1110 (800ns high)
+#define PIXEL_SPI_BIT0 0b1000
+#define PIXEL_SPI_BIT1 0b1110
+
+PhotonWS2812Pixel * volatile PhotonWS2812Pixel::spiActive = NULL;
+
+// gamma 2.8: round(pow(value / 255, 2.8) * 255)
+const byte ws2812Gamma[256] = {
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,
+          1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+          2,   3,   3,   3,   3,   3,   3,   3,   4,   4,   4,   4,   4,   5,   5,   5,
+          5,   6,   6,   6,   6,   7,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,
+         10,  10,  11,  11,  11,  12,  12,  13,  13,  13,  14,  14,  15,  15,  16,  16,
+         17,  17,  18,  18,  19,  19,  20,  20,  21,  21,  22,  22,  23,  24,  24,  25,
+         25,  26,  27,  27,  28,  29,  29,  30,  31,  32,  32,  33,  34,  35,  35,  36,
+         37,  38,  39,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  50,
+         51,  52,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,  64,  66,  67,  68,
+         69,  70,  72,  73,  74,  75,  77,  78,  79,  81,  82,  83,  85,  86,  87,  89,
+         90,  92,  93,  95,  96,  98,  99, 101, 102, 104, 105, 107, 109, 110, 112, 114,
+        115, 117, 119, 120, 122, 124, 126, 127, 129, 131, 133, 135, 137, 138, 140, 142,
+        144, 146, 148, 150, 152, 154, 156, 158, 160, 162, 164, 167, 169, 171, 173, 175,
+        177, 180, 182, 184, 186, 189, 191, 193, 196, 198, 200, 203, 205, 208, 210, 213,
+        215, 218, 220, 223, 225, 228, 231, 233, 236, 239, 241, 244, 247, 249, 252, 255,
+};
+
+// byte offsets of r, g, b within a PixelColor for each PhotonWS2812Pixel::ColorOrder
+const byte ws2812Orders[6][3] = { {1, 0, 2}, {0, 1, 2}, {2, 0, 1}, {0, 2, 1}, {1, 2, 0}, {2, 1, 0} };
+
+// one SPI byte carrying WS2812 bits 'bit' and 'bit - 1' of value
+constexpr byte ws2812SpiPair(byte value, int bit) {
+    return (byte) ((((value >> bit) & 1 ? PIXEL_SPI_BIT1 : PIXEL_SPI_BIT0) << 4) |
+                    ((value >> (bit - 1)) & 1 ? PIXEL_SPI_BIT1 : PIXEL_SPI_BIT0));
+}
+
+// the 4 SPI bytes for a color byte, packed so a little-endian 32-bit store puts them on the wire in order
+constexpr uint32_t ws2812SpiCode(byte value) {
+    return (uint32_t) ws2812SpiPair(value, 7) | ((uint32_t) ws2812SpiPair(value, 5) << 8) |
+           ((uint32_t) ws2812SpiPair(value, 3) << 16) | ((uint32_t) ws2812SpiPair(value, 1) << 24);
+}
+
+static_assert(ws2812SpiCode(0x00) == 0x88888888 && ws2812SpiCode(0xA5) == 0x8E8EE8E8, "ws2812SpiCode");
+
+#define PIXEL_SPI_CODE4(n) ws2812SpiCode(n), ws2812SpiCode(n + 1), ws2812SpiCode(n + 2), ws2812SpiCode(n + 3)
+#define PIXEL_SPI_CODE16(n) PIXEL_SPI_CODE4(n), PIXEL_SPI_CODE4(n + 4), PIXEL_SPI_CODE4(n + 8), PIXEL_SPI_CODE4(n + 12)
+#define PIXEL_SPI_CODE64(n) PIXEL_SPI_CODE16(n), PIXEL_SPI_CODE16(n + 16), PIXEL_SPI_CODE16(n + 32), PIXEL_SPI_CODE16(n + 48)
+
+// color byte -> SPI line code, built at compile time (1KB of flash)
+const uint32_t ws2812SpiCodes[256] = {
+        PIXEL_SPI_CODE64(0), PIXEL_SPI_CODE64(64), PIXEL_SPI_CODE64(128), PIXEL_SPI_CODE64(192)
+};
+
+void ws2812Encode(const PixelColor *pixels, int count, byte *buffer) {
+    for (int idx = 0; idx < count; idx++) {
+        memcpy(buffer, &ws2812SpiCodes[pixels[idx].g], 4);
+        memcpy(buffer + 4, &ws2812SpiCodes[pixels[idx].r], 4);
+        memcpy(buffer + 8, &ws2812SpiCodes[pixels[idx].b], 4);
+        buffer += PIXEL_SPI_BYTES_PER_PIXEL;
+    }
+}
 
 /*
  * constructors/destructors
  */
 
-PhotonWS2812Pixel::PhotonWS2812Pixel(PixelColor *pixels, int pixelCount, byte pin) {
+PhotonWS2812Pixel::PhotonWS2812Pixel(PixelColor *pixels, int pixelCount, byte pin, byte *frame) {
     this->pixelCount = pixelCount;
     this->pixels = pixels;
     this->pin = pin;
     this->refresh = true;
+    this->forceRefresh = false;
+    this->frame = frame;
+    memcpy(this->order, ws2812Orders[GRB], 3);
+    this->brightness = 255;
+    this->gamma = false;
+    this->sentHash = 0;
+    this->framesSent = 0;
+    this->framesSkipped = 0;
+    this->pinSet = NULL;
+    this->pinReset = NULL;
+    this->pinMask = 0;
+    this->sendBits = &PhotonWS2812Pixel::sendFrame<0, 0>;
+    this->chunkPixels = 0;
+    this->maxIrqOffTicks = 0;
+    this->framesRestarted = 0;
+    this->framesDeferred = 0;
+    this->spi = NULL;
+    this->spiBuffer = NULL;
+    this->transmitHandler = NULL;
 }
 
 PhotonWS2812Pixel::~PhotonWS2812Pixel() {
@@ -319,10 +832,38 @@ void PhotonWS2812Pixel::setup() {
     digitalWrite(pin, LOW);
 }
 
+bool PhotonWS2812Pixel::setupSPI(SPIClass *spi, byte *buffer, PixelTransmitHandler *handler) {
+    // the frames can only come out of the SPI's MOSI pin, anything else would send them where the pixels aren't
+    if (pin != (spi == &SPI ? A5 : spi == &SPI1 ? D2 : PIXEL_NO_PIN)) return false;
+    this->spi = spi;
+    this->spiBuffer = buffer;
+    this->transmitHandler = handler;
+    memset(spiBuffer, 0, PIXEL_SPI_BUFFER_SIZE(pixelCount));  // the trailing reset bytes are never written again
+    spi->begin();
+    spi->setBitOrder(MSBFIRST);
+    spi->setDataMode(SPI_MODE0);
+    spi->setClockSpeed(PIXEL_SPI_CLOCK);
+    refresh = true;
+    return true;
+}
+
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "CannotResolve"
 void PhotonWS2812Pixel::update(bool refresh) {
-    if (!this->refresh && !refresh) return;
+    if (refresh) forceRefresh = true;
+    if (!this->refresh && !forceRefresh) return;
+    // most animations only change on a step, don't resend a frame the pixels are already showing (unless forced,
+    // e.g. the strip was powered up or glitched)
+    uint32_t hash = frameHash();
+    if (!forceRefresh && framesSent && hash == sentHash) {
+        framesSkipped++;
+        this->refresh = false;
+        return;
+    }
+    if (spi) {
+        transmitSPI(hash);
+        return;
+    }
     // Data latch = 50 microsecond pause in the output stream.  Rather than
     // put a delay at the end of the function, the ending time is noted and
     // the function will simply hold off (if needed) on issuing the
@@ -334,35 +875,90 @@ void PhotonWS2812Pixel::update(bool refresh) {
     // instances on different pins can be quickly issued in succession (each
     // instance doesn't delay the next).
 
-    __disable_irq(); // Need 100% focus on instruction timing
+    // color order, brightness and gamma are applied now so none of it happens with interrupts disabled
+    if (frame) prepareFrame();
+    if (!pinSet) resolvePin();
+
+    if (!(this->*sendBits)()) {
+        // the pixels may show part of it, resend on the next update() even if nothing changes by then
+        framesDeferred++;
+        forceRefresh = true;
+        endTime = micros();
+        return;
+    }
+    endTime = micros(); // Save EOD time for latch on next call
+    this->refresh = false;
+    forceRefresh = false;
+    sentHash = hash;
+    framesSent++;
+}
+
+template<uint32_t Port, uint16_t Mask>
+bool PhotonWS2812Pixel::sendFrame() {
+    // a constant port folds into the store instructions, otherwise the registers are loaded once, not per bit
+    volatile uint16_t * const setRegister = Port ? (volatile uint16_t *) (Port + WS2812_BSRRL_OFFSET) : pinSet;
+    volatile uint16_t * const resetRegister = Port ? (volatile uint16_t *) (Port + WS2812_BSRRH_OFFSET) : pinReset;
+    const uint16_t pinBit = Port ? Mask : pinMask;
 
     volatile uint32_t
             c,    // 24-bit pixel color
             mask; // 8-bit mask
     volatile int i = pixelCount; // Output loop counter
     volatile uint8_t
-            j,              // 8-bit inner loop counter
-            g,              // Current green byte value
-            r,              // Current red byte value
-            b;              // Current blue byte value
-    volatile PixelColor *pixptr = pixels;
+            j;              // 8-bit inner loop counter
+    volatile const byte *wire = frame; // Next wire ordered bytes (when prepared)
+    const PixelColor *pixptr = pixels;
+    int chunk = chunkPixels ? chunkPixels + 1 : 0; // Pixels left (+1) until interrupts are let in, 0 = never
+    int restarts = 0;
+    uint32_t gapTicks = PIXEL_CHUNK_MAX_GAP * System.ticksPerMicrosecond();
+
+    __disable_irq(); // Need 100% focus on instruction timing
+    uint32_t offStart = System.ticks();
 
     while(i) { // While pixels left...
+        if (chunk && !--chunk) {
+            // the line stays low while pending interrupts run, which the pixels take as a long bit
+            uint32_t now = System.ticks();
+            if (now - offStart > maxIrqOffTicks) maxIrqOffTicks = now - offStart;
+            __enable_irq();
+            __disable_irq();
+            offStart = System.ticks();
+            chunk = chunkPixels;
+            if (offStart - now > gapTicks) {
+                // long enough that the pixels may have latched the partial frame, start over (after a few
+                // tries give up until the next update(), the chunks stay bounded however busy the system is)
+                framesRestarted++;
+                if (++restarts >= PIXEL_CHUNK_RESTARTS) {
+                    __enable_irq();
+                    return false;
+                }
+                i = pixelCount;
+                wire = frame;
+                pixptr = pixels;
+                __enable_irq();
+                delayMicroseconds(PIXEL_WAIT_TIME);
+                __disable_irq();
+                offStart = System.ticks();
+            }
+        }
         i--;      // decrement bytes remaining
-        r = (*pixptr).r;   // Next red byte value
-        g = (*pixptr).g;   // Next green byte value
-        b = (*pixptr++).b;   // Next blue byte value
-        c = ((uint32_t)g << 16) | ((uint32_t)r <<  8) | b; // Pack the next 3 bytes to keep timing tight
+        if (wire) {
+            c = ((uint32_t)wire[0] << 16) | ((uint32_t)wire[1] <<  8) | wire[2]; // Pack the next 3 bytes to keep timing tight
+            wire += 3;
+        }
+        else {
+            c = orderedColor(*pixptr++); // no frame buffer, only reorder (no brightness/gamma with interrupts off)
+        }
 
         mask = 0x800000; // reset the mask
         j = 0; // reset the 24-bit counter
         do {
-            bbPinHI(pin);
+            bbPinHI();
             if (c & mask) { // if masked bit is high
                 // WS2812 spec             700ns HIGH
                 // Adafruit on Arduino    (meas. 812ns)
                 // This lib on Photon     (meas. 792ns)
-                asm volatile(
+                bbDelay(
                     "mov r0, r0" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
@@ -379,12 +975,12 @@ void PhotonWS2812Pixel::update(bool refresh) {
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
-                ::: "r0", "cc", "memory");
+                );
                 // WS2812 spec             600ns LOW
                 // Adafruit on Arduino    (meas. 436ns)
                 // This lib on Photon     (meas. 434ns)
-                bbPinLO(pin);
-                asm volatile(
+                bbPinLO();
+                bbDelay(
                     "mov r0, r0" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
@@ -392,23 +988,23 @@ void PhotonWS2812Pixel::update(bool refresh) {
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t"
-                ::: "r0", "cc", "memory");
+                );
             }
             else { // else masked bit is low
                 // WS2812 spec             350ns HIGH
                 // Adafruit on Arduino    (meas. 312ns)
                 // This lib on Photon     (meas. 308ns)
-                asm volatile(
+                bbDelay(
                     "mov r0, r0" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
-                ::: "r0", "cc", "memory");
+                );
                 // WS2812 spec             800ns LOW
                 // Adafruit on Arduino    (meas. 938ns)
                 // This lib on Photon     (meas. 934ns)
-                bbPinLO(pin);
-                asm volatile(
+                bbPinLO();
+                bbDelay(
                     "mov r0, r0" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
@@ -427,21 +1023,34 @@ void PhotonWS2812Pixel::update(bool refresh) {
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t" "nop" "\n\t"
                     "nop" "\n\t" "nop" "\n\t"
-                ::: "r0", "cc", "memory");
+                );
             }
             mask >>= 1;
         } while ( ++j < 24 ); // ... pixel done
     } // end while(i) ... no more pixels
 
+    uint32_t offTicks = System.ticks() - offStart;
     __enable_irq();
 
-    endTime = micros(); // Save EOD time for latch on next call
-    this->refresh = false;
+    if (offTicks > maxIrqOffTicks) maxIrqOffTicks = offTicks;
+    return true;
 }
 #pragma clang diagnostic pop
 
+// the registers looked up at run time, and on the Photon every GPIO pin's as constants for PhotonWS2812Strip (the
+// linker drops the ones that aren't used)
+template bool PhotonWS2812Pixel::sendFrame<0, 0>();
+#if defined(__arm__)
+#define PIXEL_SEND_FRAME_PIN(pin) template bool PhotonWS2812Pixel::sendFrame<ws2812PinPorts[pin], ws2812PinMasks[pin]>();
+PIXEL_SEND_FRAME_PIN(D0) PIXEL_SEND_FRAME_PIN(D1) PIXEL_SEND_FRAME_PIN(D2) PIXEL_SEND_FRAME_PIN(D3)
+PIXEL_SEND_FRAME_PIN(D4) PIXEL_SEND_FRAME_PIN(D5) PIXEL_SEND_FRAME_PIN(D6) PIXEL_SEND_FRAME_PIN(D7)
+PIXEL_SEND_FRAME_PIN(A0) PIXEL_SEND_FRAME_PIN(A1) PIXEL_SEND_FRAME_PIN(A2) PIXEL_SEND_FRAME_PIN(A3)
+PIXEL_SEND_FRAME_PIN(A4) PIXEL_SEND_FRAME_PIN(A5) PIXEL_SEND_FRAME_PIN(A6) PIXEL_SEND_FRAME_PIN(A7)
+PIXEL_SEND_FRAME_PIN(RX) PIXEL_SEND_FRAME_PIN(TX)
+#endif
+
 void PhotonWS2812Pixel::setPixelColor(int pixel, PixelColor pixelColor) {
-    if (pixel < pixelCount) {
+    if (pixel >= 0 && pixel < pixelCount) {
         pixels[pixel] = pixelColor;
         refresh = true;
     }
@@ -451,27 +1060,373 @@ void PhotonWS2812Pixel::triggerRefresh() {
     this->refresh = true;
 }
 
+bool PhotonWS2812Pixel::isTransmitting() {
+    return spiActive == this;
+}
+
+void PhotonWS2812Pixel::setPinRegisters(volatile uint16_t *set, volatile uint16_t *reset, uint16_t mask) {
+    pinSet = set;
+    pinReset = reset;
+    pinMask = mask;
+}
+
+void PhotonWS2812Pixel::setColorOrder(ColorOrder order) {
+    memcpy(this->order, ws2812Orders[order], 3);
+    refresh = true;
+}
+
+void PhotonWS2812Pixel::setBrightness(byte brightness) {
+    this->brightness = brightness;
+    refresh = true;
+}
+
+byte PhotonWS2812Pixel::getBrightness() { return brightness; }
+
+void PhotonWS2812Pixel::setGamma(bool gamma) {
+    this->gamma = gamma;
+    refresh = true;
+}
+
+unsigned long PhotonWS2812Pixel::getFramesSent() { return framesSent; }
+
+unsigned long PhotonWS2812Pixel::getFramesSkipped() { return framesSkipped; }
+
+void PhotonWS2812Pixel::setMaxInterruptOff(unsigned int window) {
+    // whole pixels only, the bits within a pixel can't be stretched
+    chunkPixels = window ? max(1U, window / PIXEL_BITBANG_TIME) : 0;
+    maxIrqOffTicks = 0;
+}
+
+unsigned long PhotonWS2812Pixel::getMaxInterruptOff() { return maxIrqOffTicks / System.ticksPerMicrosecond(); }
+
+unsigned long PhotonWS2812Pixel::getFramesRestarted() { return framesRestarted; }
+
+unsigned long PhotonWS2812Pixel::getFramesDeferred() { return framesDeferred; }
+
+/*
+ * private helpers
+ */
+
+byte PhotonWS2812Pixel::level(byte value) {
+    if (gamma) value = ws2812Gamma[value];
+    return (byte) ((value * (brightness + 1)) >> 8);
+}
+
+uint32_t PhotonWS2812Pixel::orderedColor(const PixelColor &color) {
+    const byte *rgb = (const byte *) &color;
+    return ((uint32_t) rgb[order[0]] << 16) | ((uint32_t) rgb[order[1]] << 8) | rgb[order[2]];
+}
+
+void PhotonWS2812Pixel::prepareFrame() {
+    byte *out = frame;
+    for (int idx = 0; idx < pixelCount; idx++) {
+        const byte *rgb = (const byte *) &pixels[idx];
+        *out++ = level(rgb[order[0]]);
+        *out++ = level(rgb[order[1]]);
+        *out++ = level(rgb[order[2]]);
+    }
+}
+
+void PhotonWS2812Pixel::resolvePin() {
+    setPinRegisters(&BB_PIN_MAP[pin].gpio_peripheral->BSRRL, &BB_PIN_MAP[pin].gpio_peripheral->BSRRH,
+                    BB_PIN_MAP[pin].gpio_pin);
+}
+
+void PhotonWS2812Pixel::encodeSPI() {
+    if (brightness == 255 && !gamma && order[0] == 1 && order[1] == 0) {
+        ws2812Encode(pixels, pixelCount, spiBuffer);
+        return;
+    }
+    // color order, brightness and gamma fused into the line code lookup
+    byte *out = spiBuffer;
+    for (int idx = 0; idx < pixelCount; idx++) {
+        const byte *rgb = (const byte *) &pixels[idx];
+        memcpy(out, &ws2812SpiCodes[level(rgb[order[0]])], 4);
+        memcpy(out + 4, &ws2812SpiCodes[level(rgb[order[1]])], 4);
+        memcpy(out + 8, &ws2812SpiCodes[level(rgb[order[2]])], 4);
+        out += PIXEL_SPI_BYTES_PER_PIXEL;
+    }
+}
+
+void PhotonWS2812Pixel::transmitSPI(uint32_t hash) {
+    // the buffer belongs to DMA until the current frame is done, queue the refresh (even a forced one) until then
+    if (spiActive) {
+        this->refresh = true;
+        return;
+    }
+    encodeSPI();
+    spiActive = this;
+    this->refresh = false;
+    forceRefresh = false;
+    sentHash = hash;
+    framesSent++;
+    spi->transfer(spiBuffer, NULL, PIXEL_SPI_BUFFER_SIZE(pixelCount), &spiTransmitComplete);
+}
+
+uint32_t PhotonWS2812Pixel::frameHash() {
+    // FNV-1a over the output settings and color bytes, cheap enough to run on every refresh
+    const byte *data = (const byte *) pixels;
+    uint32_t hash = 2166136261UL ^ ((uint32_t) brightness << 24 | (uint32_t) gamma << 16 | order[0] << 8 | order[1]);
+    for (int idx = 0; idx < pixelCount * 3; idx++) {
+        hash = (hash ^ data[idx]) * 16777619UL;
+    }
+    return hash;
+}
+
+void PhotonWS2812Pixel::spiTransmitComplete() {
+    PhotonWS2812Pixel *pixel = spiActive;
+    if (pixel) {
+        pixel->endTime = micros();
+        spiActive = NULL;
+        if (pixel->transmitHandler) { (*pixel->transmitHandler)(pixel); }
+    }
+}
+
+
+
+/*************************
+ * PhotonWS2812Parallel
+ */
+
+// WS2812B bit timing in ns, 0 = 350 high then 900 low, 1 = 800 high then 450 low
+#define PIXEL_PARALLEL_T0H 350
+#define PIXEL_PARALLEL_T1H 800
+#define PIXEL_PARALLEL_BIT 1250
+
+void ws2812Transpose8(const byte in[8], byte out[8]) {
+    // Hacker's Delight transpose8 on two 32-bit halves, lane 7 is the top row so lane i ends up in bit i
+    uint32_t x = ((uint32_t) in[7] << 24) | ((uint32_t) in[6] << 16) | ((uint32_t) in[5] << 8) | in[4];
+    uint32_t y = ((uint32_t) in[3] << 24) | ((uint32_t) in[2] << 16) | ((uint32_t) in[1] << 8) | in[0];
+    uint32_t t;
+
+    t = (x ^ (x >> 7)) & 0x00AA00AA;  x = x ^ t ^ (t << 7);
+    t = (y ^ (y >> 7)) & 0x00AA00AA;  y = y ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC;  x = x ^ t ^ (t << 14);
+    t = (y ^ (y >> 14)) & 0x0000CCCC;  y = y ^ t ^ (t << 14);
+    t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+    y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+    x = t;
+
+    out[0] = (byte) (x >> 24);  out[1] = (byte) (x >> 16);  out[2] = (byte) (x >> 8);  out[3] = (byte) x;
+    out[4] = (byte) (y >> 24);  out[5] = (byte) (y >> 16);  out[6] = (byte) (y >> 8);  out[7] = (byte) y;
+}
+
+/*
+ * constructors/destructors
+ */
+
+PhotonWS2812Parallel::PhotonWS2812Parallel(uint16_t *slots, int pixelCount) {
+    this->slots = slots;
+    this->pixelCount = pixelCount;
+    this->stripCount = 0;
+    memset(this->laneMasks, 0, sizeof(this->laneMasks));
+    this->pinSet = NULL;
+    this->pinReset = NULL;
+    this->pinMask = 0;
+    this->endTime = 0;
+    this->framesSent = 0;
+    uint32_t ticksPerMicro = System.ticksPerMicrosecond();
+    this->t0High = ticksPerMicro * PIXEL_PARALLEL_T0H / 1000;
+    this->t1High = ticksPerMicro * PIXEL_PARALLEL_T1H / 1000;
+    this->tBit = ticksPerMicro * PIXEL_PARALLEL_BIT / 1000;
+}
+
+/*
+ * public api
+ */
+
+bool PhotonWS2812Parallel::addStrip(PhotonWS2812Pixel *strip) {
+    if (stripCount >= PIXEL_PARALLEL_MAX_STRIPS || strip->pixelCount > pixelCount || !strip->frame) return false;
+    if (!strip->pinSet) strip->resolvePin();
+    if (stripCount && (strip->pinSet != pinSet || (strip->pinMask & pinMask))) return false;
+
+    pinSet = strip->pinSet;
+    pinReset = strip->pinReset;
+    pinMask |= strip->pinMask;
+    byte lane = stripCount++;
+    uint16_t *masks = laneMasks[lane >> 3];
+    for (int value = 0; value < 256; value++) {
+        if (value & (1 << (lane & 7))) masks[value] |= strip->pinMask;
+    }
+    strips[lane] = strip;
+    return true;
+}
+
+void PhotonWS2812Parallel::setup() {
+    for (int idx = 0; idx < stripCount; idx++) {
+        strips[idx]->setup();
+    }
+}
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "CannotResolve"
+void PhotonWS2812Parallel::update(bool refresh) {
+    for (int idx = 0; idx < stripCount && !refresh; idx++) {
+        refresh = strips[idx]->refresh;
+    }
+    if (!refresh || !stripCount) return;
+
+    for (int idx = 0; idx < stripCount; idx++) {
+        strips[idx]->prepareFrame();
+    }
+    transposeFrames();
+    while((micros() - endTime) < PIXEL_WAIT_TIME); // latch, see PhotonWS2812Pixel::update
+
+    volatile uint16_t *set = pinSet;
+    volatile uint16_t *reset = pinReset;
+    uint16_t all = pinMask;
+    const uint16_t *slot = slots;
+    const uint16_t *end = slots + PIXEL_PARALLEL_BUFFER_SIZE(pixelCount);
+    uint32_t t0 = t0High, t1 = t1High, bit = tBit;
+
+    __disable_irq(); // edges are timed from the cycle counter rather than counted nops
+
+    uint32_t start = System.ticks();
+    while (slot < end) {
+        *set = all;
+        uint16_t zeros = *slot++;
+        while (System.ticks() - start < t0);
+        *reset = zeros;
+        while (System.ticks() - start < t1);
+        *reset = all;
+        while (System.ticks() - start < bit);
+        start += bit;
+    }
+
+    __enable_irq();
+
+    endTime = micros();
+    framesSent++;
+    for (int idx = 0; idx < stripCount; idx++) {
+        PhotonWS2812Pixel *strip = strips[idx];
+        strip->refresh = false;
+        strip->sentHash = strip->frameHash();
+        strip->framesSent++;
+    }
+}
+#pragma clang diagnostic pop
+
+unsigned long PhotonWS2812Parallel::getFramesSent() { return framesSent; }
+
+/*
+ * private helpers
+ */
+
+void PhotonWS2812Parallel::transposeFrames() {
+    // one byte position of every lane at a time, so each lane's frame is read in order and the 8x8 transposes
+    // stay in registers, the slot for each bit is the pins whose lanes send a 0 there
+    byte lanes[8];
+    byte bits[8];
+    uint16_t *out = slots;
+    for (int pos = 0; pos < pixelCount * 3; pos++) {
+        uint16_t ones[8] = {0};
+        for (int group = 0; group * 8 < stripCount; group++) {
+            for (int lane = 0; lane < 8; lane++) {
+                int idx = group * 8 + lane;
+                lanes[lane] = idx < stripCount && pos < strips[idx]->pixelCount * 3 ? strips[idx]->frame[pos] : 0;
+            }
+            ws2812Transpose8(lanes, bits);
+            for (int bit = 0; bit < 8; bit++) {
+                ones[bit] |= laneMasks[group][bits[bit]];
+            }
+        }
+        for (int bit = 0; bit < 8; bit++) {
+            *out++ = pinMask & ~ones[bit];
+        }
+    }
+}
 
 
 /*************************
  * PhotonADXL362Accel
  */
 
+static_assert((ADXL_SAMPLE_RING_SIZE & (ADXL_SAMPLE_RING_SIZE - 1)) == 0 && ADXL_SAMPLE_RING_SIZE <= 0x8000,
+              "ADXL_SAMPLE_RING_SIZE");
+
+static byte *putLittleEndian(byte *out, uint32_t value, int bytes) {
+    while (bytes--) {
+        *out++ = (byte) value;
+        value >>= 8;
+    }
+    return out;
+}
+
 /*
  * constructors/destructors
  */
 
+PhotonADXL362Accel * volatile PhotonADXL362Accel::spiActive = NULL;
+PhotonADXL362Accel * volatile PhotonADXL362Accel::activityAccel = NULL;
+
 PhotonADXL362Accel::PhotonADXL362Accel(byte pin) : pin(pin) {
     state = WAITING;
-}
-
-void PhotonADXL362Accel::setup(unsigned int refreshRate) {
-    stateWait[RUNNING] = refreshRate;
+    memset(spiTx, 0, sizeof(spiTx));
+    sampleReady = false;
+    readMicros = 0;
+    motionMicros = 0;
+    dataRate = ODR_100;
+    fifoWatermark = 0;
+    fifoBytes = 0;
+    fifoSamples = 0;
+    activityPin = 0;
+    activityThreshold = 0;
+    activityTime = ADXL_INACTIVE_TIME;
+    activityChanged = false;
+    awake = true;
+    sampleMillis = 0;
+    filter = &defaultFilter;
+    filterReset = true;
+    memset(filtered, 0, sizeof(filtered));
+    pitchPhase = rollPhase = 0;
+    fx = fy = fz = 0;
+    angle = 180;
+    azimuth = 270;
+    ringHead = ringTail = 0;
+    ringDropped = 0;
+    rate = dataRate;
+    runningRefresh = stateWait[RUNNING];
+    stillRefresh = 0;
+    stillAfter = ADXL_STILL_AFTER;
+    stillRate = ODR_12_5;
+    still = false;
+    moving = false;
+    motionSamples = 0;
+    stillSamples = 0;
+}
+
+void PhotonADXL362Accel::setup(unsigned int refreshRate, AccelFilter *filter) {
+    stateWait[RUNNING] = runningRefresh = refreshRate;
+    this->filter = filter ? filter : &defaultFilter;
+    filterReset = true;
     state = STARTUP;
 }
 
 void PhotonADXL362Accel::update(system_tick_t millis) {
-    if (millis < nextUpdate) return;
+    if (sampleReady) {
+        // an asynchronous read has completed since the last update
+        sampleReady = false;
+        if (fifoBytes) decodeFIFO();
+        else {
+            decodeXYZT();
+            stateRunning((activityThreshold ? millis - sampleMillis : stateWait[RUNNING]) * 1000UL);
+            recordSample(readMicros);
+        }
+        sampleMillis = millis;
+    }
+    if (activityChanged && state == RUNNING && spiActive != this) {
+        // the sensor started or stopped moving, the time since the last sample goes to the previous state
+        activityChanged = false;
+        spiReadXYZT();
+        stateRunning((millis - sampleMillis) * 1000UL);
+        awake = (spiRead8(XL362_STATUS) & XL362_STATUS_AWAKE) != 0;
+        stateRunning(0);
+        recordSample(micros());
+        sampleMillis = millis;
+        nextUpdate = millis;
+    }
+    if (stillRefresh && state == RUNNING && spiActive != this) updateRate(millis);
+    if (millis < nextUpdate || spiActive == this) return;
     nextUpdate = millis + stateWait[state];
 
     switch (state) {
@@ -479,8 +1434,11 @@ void PhotonADXL362Accel::update(system_tick_t millis) {
             break;
         case STARTUP:
             pinMode(pin, OUTPUT);
+            digitalWrite(pin, HIGH);
             SPI.begin();
+            SPI.setBitOrder(MSBFIRST);
             SPI.setDataMode(SPI_MODE0);
+            SPI.setClockSpeed(ADXL_SPI_CLOCK, MHZ);
             state = RESET;
             break;
         case RESET:
@@ -488,6 +1446,16 @@ void PhotonADXL362Accel::update(system_tick_t millis) {
             state = POWER;
             break;
         case POWER:
+            spiWrite8(XL362_FILTER_CTL, (byte) ((spiRead8(XL362_FILTER_CTL) & 0b11111000) | dataRate));
+            rate = dataRate;
+            still = false;
+            stateWait[RUNNING] = runningRefresh;
+            if (activityThreshold) writeActivity();
+            if (fifoWatermark) {
+                spiWrite8(XL362_FIFO_SAMPLES, (byte) (fifoWatermark * 3));
+                spiWrite8(XL362_FIFO_CONTROL, (byte) (XL362_FIFO_MODE_STREAM |
+                                                      (fifoWatermark * 3 > 0xFF ? XL362_FIFO_FLAG_AH : 0)));
+            }
             spiWrite8(XL362_POWER_CTL,
                       (byte) ((spiRead8(XL362_POWER_CTL) & 0b11111100) | XL362_POWER_FLAG_MEASURE_RUNING) );
             state = CALIBRATING;
@@ -497,35 +1465,135 @@ void PhotonADXL362Accel::update(system_tick_t millis) {
             stateCalibrating();
             break;
         case RUNNING:
-            stateRunning();
+            if (activityThreshold && !awake) break;  // nothing to read until the sensor reports activity
+            // read in the background with DMA, the sample(s) are handled on a later update()
+            if (fifoWatermark) readFIFO();
+            else spiBurst(SPI_READ_INSTRUCTION, XL362_XDATA_L, XL362_XYZT_BYTES, true);
             break;
     }
 }
 
-void PhotonADXL362Accel::setMotionHandler(MotionHandler *handler) {
-    motionHandler = handler;
+system_tick_t PhotonADXL362Accel::nextDeadline() {
+    // a finished background read (or one about to finish) is due now, not a refresh later: the millis of the update
+    // that started it is never ahead of the caller's
+    if (sampleReady || spiActive == this) return nextUpdate - stateWait[state];
+    if (state == WAITING || (state == RUNNING && activityThreshold && !awake)) return DEADLINE_NONE;
+    return nextUpdate;
 }
 
-unsigned long PhotonADXL362Accel::inMotion() { return motionMillis; }
+void PhotonADXL362Accel::setFIFO(ODR odr, uint16_t watermark) {
+    dataRate = odr;
+    fifoWatermark = min(watermark, (uint16_t) ADXL_FIFO_MAX_SAMPLES);
+    // drain when the watermark should have been reached, the sample period is 80ms >> odr
+    if (fifoWatermark) stateWait[RUNNING] = runningRefresh = max(1UL, (unsigned long) fifoWatermark * 80 >> odr);
+    if (state > RESET) state = RESET;  // the FIFO and rate are set up in standby
+}
 
-unsigned long PhotonADXL362Accel::notInMotion() { return noMotionMillis; }
+unsigned long PhotonADXL362Accel::getFIFOSamples() { return fifoSamples; }
 
-double PhotonADXL362Accel::getPitch() {
-    return (atan2(fx, sqrt(pow(fy, 2) + pow(fz, 2))) * 180.0) / M_PI;
+void PhotonADXL362Accel::setAdaptiveRate(unsigned int stillRefresh, unsigned int stillAfter, ODR stillRate) {
+    this->stillRefresh = stillRefresh;
+    this->stillAfter = stillAfter;
+    this->stillRate = stillRate;
 }
 
-double PhotonADXL362Accel::getRoll() {
-    return (atan2(-fy, fz) * 180.0) / M_PI;
+unsigned long PhotonADXL362Accel::getMotionSamples() { return motionSamples; }
+
+unsigned long PhotonADXL362Accel::getStillSamples() { return stillSamples; }
+
+int PhotonADXL362Accel::availableSamples() { return (uint16_t) (ringHead - ringTail); }
+
+int PhotonADXL362Accel::readSamples(AccelSample *samples, int count) {
+    uint16_t tail = ringTail;
+    int read = 0;
+    while (read < count && tail != ringHead) {
+        std::atomic_signal_fence(std::memory_order_acquire);
+        samples[read++] = ring[tail++ & (ADXL_SAMPLE_RING_SIZE - 1)];
+    }
+    ringTail = tail;
+    return read;
+}
+
+int PhotonADXL362Accel::encodeSamples(byte *buffer, int size) {
+    byte *out = buffer;
+    uint16_t tail = ringTail;
+    while (tail != ringHead && buffer + size - out >= ADXL_FRAME_BYTES(1)) {
+        byte *frame = out;
+        int count = 0;
+        unsigned long last = 0;
+        out += ADXL_FRAME_HEADER_BYTES;
+        while (tail != ringHead && count < ADXL_FRAME_MAX_SAMPLES &&
+               frame + ADXL_FRAME_BYTES(count + 1) <= buffer + size) {
+            std::atomic_signal_fence(std::memory_order_acquire);
+            const AccelSample &sample = ring[tail & (ADXL_SAMPLE_RING_SIZE - 1)];
+            unsigned long delta = count ? sample.micros - last : 0;
+            if (delta > ADXL_FRAME_MAX_DELTA) break;  // the next frame starts with its full timestamp
+            if (!count) putLittleEndian(frame + 3, sample.micros, 4);
+            out = putLittleEndian(out, delta, 3);
+            out = putLittleEndian(out, (uint16_t) sample.x, 2);
+            out = putLittleEndian(out, (uint16_t) sample.y, 2);
+            out = putLittleEndian(out, (uint16_t) sample.z, 2);
+            last = sample.micros;
+            count++;
+            tail++;
+        }
+        frame[0] = ADXL_FRAME_SYNC0;
+        frame[1] = ADXL_FRAME_SYNC1;
+        frame[2] = (byte) count;
+        byte checksum = 0;
+        for (byte *data = frame + 2; data < out; data++) checksum += *data;
+        *out++ = checksum;
+    }
+    ringTail = tail;
+    return (int) (out - buffer);
 }
 
-int PhotonADXL362Accel::getAngle() {
-    return (int) ((atan2(fy, fx) * 180.0) / M_PI) + 180;
+unsigned long PhotonADXL362Accel::getDroppedSamples() { return ringDropped; }
+
+void PhotonADXL362Accel::setActivityInterrupt(byte intPin, uint16_t threshold, unsigned int inactiveTime) {
+    if (activityThreshold) {
+        detachInterrupt(activityPin);
+        activityAccel = NULL;
+    }
+    activityPin = intPin;
+    activityThreshold = min(threshold, (uint16_t) 0x7FF);
+    activityTime = inactiveTime;
+    activityChanged = false;
+    awake = true;
+    if (activityThreshold) {
+        activityAccel = this;
+        pinMode(activityPin, INPUT);
+        attachInterrupt(activityPin, &activityInterrupt, CHANGE);
+    }
+    if (state > RESET) state = RESET;  // the activity registers are set up in standby
 }
 
-int PhotonADXL362Accel::getAzimuth(){
-    return (90 - getAngle() + 360) % 360;
+void PhotonADXL362Accel::setMotionHandler(MotionHandler *handler) {
+    motionHandler = handler;
 }
 
+unsigned long PhotonADXL362Accel::inMotion() { return motionMillis; }
+
+unsigned long PhotonADXL362Accel::notInMotion() { return noMotionMillis; }
+
+double PhotonADXL362Accel::getPitch() { return pitchPhase * (360.0 / 0x10000); }
+
+double PhotonADXL362Accel::getRoll() { return rollPhase * (360.0 / 0x10000); }
+
+int16_t PhotonADXL362Accel::getPitchPhase() { return pitchPhase; }
+
+int16_t PhotonADXL362Accel::getRollPhase() { return rollPhase; }
+
+int PhotonADXL362Accel::getAngle() { return angle; }
+
+int PhotonADXL362Accel::getAzimuth() { return azimuth; }
+
+double PhotonADXL362Accel::getFilteredX() { return filtered[0] * (1.0 / (1 << ACCEL_FILTER_FRACTION)); }
+
+double PhotonADXL362Accel::getFilteredY() { return filtered[1] * (1.0 / (1 << ACCEL_FILTER_FRACTION)); }
+
+double PhotonADXL362Accel::getFilteredZ() { return filtered[2] * (1.0 / (1 << ACCEL_FILTER_FRACTION)); }
+
 
 /*
  * private helpers
@@ -541,22 +1609,35 @@ void PhotonADXL362Accel::stateCalibrating() {
         yMin -= ADXL_TOLERANCE; yMax += ADXL_TOLERANCE;
         zMin -= ADXL_TOLERANCE; zMax += ADXL_TOLERANCE;
         state = RUNNING;
+        filterReset = true;  // start the filter from the first sample rather than from zero
+        if (activityThreshold) awake = (spiRead8(XL362_STATUS) & XL362_STATUS_AWAKE) != 0;
     }
 }
 
-void PhotonADXL362Accel::stateRunning(){
-    spiReadXYZT();
-    fx = (x * 0.5) + (fx * 0.5);
-    fy = (y * 0.5) + (fy * 0.5);
-    fz = (z * 0.5) + (fz * 0.5);
-    if (x < xMin || x > xMax || y < yMin || y > yMax || z < zMin || z > zMax) {
+void PhotonADXL362Accel::stateRunning(unsigned long elapsedMicros){
+    motionMicros += elapsedMicros;
+    unsigned long elapsed = motionMicros / 1000;
+    motionMicros %= 1000;
+    filtered[0] = (int32_t) x << ACCEL_FILTER_FRACTION;
+    filtered[1] = (int32_t) y << ACCEL_FILTER_FRACTION;
+    filtered[2] = (int32_t) z << ACCEL_FILTER_FRACTION;
+    (*filter->function)(filter, filtered, filterReset);
+    filterReset = false;
+    updateOrientation();
+    fx = getFilteredX();
+    fy = getFilteredY();
+    fz = getFilteredZ();
+    bool motion = activityThreshold ? awake :
+                  x < xMin || x > xMax || y < yMin || y > yMax || z < zMin || z > zMax;
+    moving = motion;
+    if (motion) {
         // motion
         if (noMotionMillis) {
             if (motionHandler) { (*motionHandler)(true, noMotionMillis); }
             motionMillis = 0;
             noMotionMillis = 0;
         }
-        motionMillis += stateWait[state];
+        motionMillis += elapsed;
     } else {
         // stationary
         if (motionMillis) {
@@ -564,37 +1645,188 @@ void PhotonADXL362Accel::stateRunning(){
             motionMillis = 0;
             noMotionMillis = 0;
         }
-        noMotionMillis += stateWait[state];
+        noMotionMillis += elapsed;
     }
 }
 
+void PhotonADXL362Accel::updateOrientation() {
+    // hypot16 takes the filtered values with 2 fraction bits
+    int32_t fx4 = filtered[0] >> (ACCEL_FILTER_FRACTION - 2);
+    int32_t fy4 = filtered[1] >> (ACCEL_FILTER_FRACTION - 2);
+    int32_t fz4 = filtered[2] >> (ACCEL_FILTER_FRACTION - 2);
+    pitchPhase = (int16_t) atan2_16(fx4, hypot16(fy4, fz4));
+    rollPhase = (int16_t) atan2_16(-fy4, fz4);
+    angle = (int) ((int16_t) atan2_16(fy4, fx4) * 360 / 0x10000) + 180;
+    azimuth = (90 - angle + 360) % 360;
+}
+
 byte PhotonADXL362Accel::spiRead8(byte regAddress) {
-    byte regValue = 0;
-    digitalWrite(pin, LOW);
-    SPI.transfer(SPI_READ_INSTRUCTION);
-    SPI.transfer(regAddress);
-    regValue = SPI.transfer(0x00);
-    digitalWrite(pin, HIGH);
-    return regValue;
+    spiBurst(SPI_READ_INSTRUCTION, regAddress, 1, false);
+    return spiRx[2];
 }
 
 void PhotonADXL362Accel::spiWrite8(byte regAddress, byte regValue) {
-    digitalWrite(pin, LOW);
-    SPI.transfer(SPI_WRITE_INSTRUCTION);
-    SPI.transfer(regAddress);
-    SPI.transfer(regValue);
-    digitalWrite(pin, HIGH);
+    spiTx[2] = regValue;
+    spiBurst(SPI_WRITE_INSTRUCTION, regAddress, 1, false);
+    spiTx[2] = 0;
 }
 
 void PhotonADXL362Accel::spiReadXYZT() {
+    spiBurst(SPI_READ_INSTRUCTION, XL362_XDATA_L, XL362_XYZT_BYTES, false);
+    decodeXYZT();
+}
+
+void PhotonADXL362Accel::spiBurst(byte instruction, byte regAddress, int length, bool async) {
+    // one chip select and one transfer for the whole register range (auto-incrementing address)
+    spiTx[0] = instruction;
+    spiTx[1] = regAddress;
+    spiTransfer(2 + length, async);
+}
+
+void PhotonADXL362Accel::spiTransfer(int length, bool async) {
     digitalWrite(pin, LOW);
-    SPI.transfer(SPI_READ_INSTRUCTION);
-    SPI.transfer(XL362_XDATA_L);
-    x = SPI.transfer(0x00) + (SPI.transfer(0x00) << 8);
-    y = SPI.transfer(0x00) + (SPI.transfer(0x00) << 8);
-    z = SPI.transfer(0x00) + (SPI.transfer(0x00) << 8);
-    t = SPI.transfer(0x00) + (SPI.transfer(0x00) << 8);
-    digitalWrite(pin, HIGH);
+    if (async) {
+        spiActive = this;
+        readMicros = micros();  // the data is read now, however late update() gets to it
+        SPI.transfer(spiTx, spiRx, (size_t) length, &spiBurstComplete);
+    } else {
+        SPI.transfer(spiTx, spiRx, (size_t) length, NULL);
+        digitalWrite(pin, HIGH);
+    }
+}
+
+void PhotonADXL362Accel::readFIFO() {
+    spiBurst(SPI_READ_INSTRUCTION, XL362_FIFO_ENTRIES_L, 2, false);
+    int entries = (spiRx[2] | (spiRx[3] << 8)) & (XL362_FIFO_ENTRIES_MAX * 2 - 1);
+    // whole XYZ samples only, the rest stay for next time
+    int samples = min(entries / 3, ADXL_FIFO_MAX_SAMPLES);
+    if (!samples) return;
+    fifoBytes = samples * 3 * XL362_FIFO_ENTRY_BYTES;
+    spiTx[0] = SPI_FIFO_INSTRUCTION;  // no address, the FIFO's data follows the instruction
+    spiTx[1] = 0;
+    spiTransfer(1 + fifoBytes, true);
+}
+
+void PhotonADXL362Accel::decodeFIFO() {
+    const byte *data = spiRx + 1;
+    unsigned long period = 80000UL >> rate;
+    // each sample is an x, y, z entry in that order (tagged in the top 2 bits); a read that starts part way through
+    // a sample would pair a stale x with the next sample's y and z, so entries are dropped until an x starts a sample
+    // (as the datasheet recommends), the first pass counts the whole samples so they can be timed
+    int complete = 0;
+    unsigned long sampleMicros = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass) {
+            // the last sample is the newest (in the FIFO when the read started), the ones before it were taken a
+            // sample period apart
+            sampleMicros = readMicros - (complete - 1) * period;
+        }
+        int expect = 0;  // tag of the next entry of the sample
+        int16_t sampleX = 0, sampleY = 0;
+        for (int idx = 0; idx < fifoBytes; idx += XL362_FIFO_ENTRY_BYTES) {
+            uint16_t entry = (uint16_t) (data[idx] | (data[idx + 1] << 8));
+            int tag = entry >> 14;
+            if (tag != expect) {
+                expect = 0;
+                if (tag != 0) continue;  // dropped, not the x of a new sample either
+            }
+            expect = tag == 2 ? 0 : tag + 1;
+            if (tag == 2 && !pass) complete++;
+            if (!pass) continue;
+            int16_t value = (int16_t) (entry << 2) >> 2;
+            if (tag == 0) sampleX = value;
+            else if (tag == 1) sampleY = value;
+            else {
+                x = sampleX;
+                y = sampleY;
+                z = value;
+                fifoSamples++;
+                stateRunning(period);
+                recordSample(sampleMicros);
+                sampleMicros += period;
+            }
+        }
+    }
+    fifoBytes = 0;
+}
+
+void PhotonADXL362Accel::writeActivity() {
+    // THRESH_ACT..ACT_INACT_CTL in one burst, one sample over the threshold is activity and inactivity is
+    // activityTime worth of samples (at the data rate) within it, AWAKE on INT1 is then high while moving
+    unsigned long inactiveSamples = min(activityTime * 1000UL / (80000UL >> rate), 0xFFFFUL);
+    byte *data = spiTx + 2;
+    data[0] = (byte) activityThreshold;
+    data[1] = (byte) (activityThreshold >> 8);
+    data[2] = 1;
+    data[3] = (byte) activityThreshold;
+    data[4] = (byte) (activityThreshold >> 8);
+    data[5] = (byte) inactiveSamples;
+    data[6] = (byte) (inactiveSamples >> 8);
+    data[7] = XL362_ACT_INACT_LOOP;
+    spiBurst(SPI_WRITE_INSTRUCTION, XL362_THRESH_ACT_L, XL362_ACTIVITY_BYTES, false);
+    memset(spiTx, 0, sizeof(spiTx));
+    spiWrite8(XL362_INTMAP1, XL362_INTMAP_AWAKE);
+}
+
+void PhotonADXL362Accel::activityInterrupt() {
+    PhotonADXL362Accel *accel = activityAccel;
+    if (accel) accel->activityChanged = true;
+}
+
+void PhotonADXL362Accel::updateRate(system_tick_t millis) {
+    // slow down once still for stillAfter, back up on the first sample in motion
+    bool slow = !moving && noMotionMillis >= stillAfter;
+    if (slow == still) return;
+    still = slow;
+    ODR odr = still ? min(stillRate, dataRate) : dataRate;
+    stateWait[RUNNING] = still ? stillRefresh : runningRefresh;
+    // one FIFO drain takes at most ADXL_FIFO_MAX_SAMPLES, polling less often than that fills the FIFO until it overflows
+    if (still && fifoWatermark) {
+        stateWait[RUNNING] = min(stateWait[RUNNING], ADXL_FIFO_MAX_SAMPLES * 80 >> odr);
+    }
+    nextUpdate = millis + stateWait[RUNNING];
+    if (odr == rate) return;
+    // the rate is changed in standby, inactivity is counted in samples so it's rewritten for the new rate
+    byte power = spiRead8(XL362_POWER_CTL);
+    spiWrite8(XL362_POWER_CTL, (byte) (power & 0b11111100));
+    spiWrite8(XL362_FILTER_CTL, (byte) ((spiRead8(XL362_FILTER_CTL) & 0b11111000) | odr));
+    rate = odr;
+    if (activityThreshold) writeActivity();
+    spiWrite8(XL362_POWER_CTL, power);
+}
+
+void PhotonADXL362Accel::recordSample(unsigned long micros) {
+    if (moving) motionSamples++;
+    else stillSamples++;
+    uint16_t head = ringHead;
+    if ((uint16_t) (head - ringTail) >= ADXL_SAMPLE_RING_SIZE) {
+        ringDropped++;  // the reader hasn't kept up, keep what it hasn't read yet
+        return;
+    }
+    AccelSample &sample = ring[head & (ADXL_SAMPLE_RING_SIZE - 1)];
+    sample.micros = micros;
+    sample.x = x;
+    sample.y = y;
+    sample.z = z;
+    std::atomic_signal_fence(std::memory_order_release);  // the sample is written before it is published
+    ringHead = head + 1;
+}
+
+void PhotonADXL362Accel::decodeXYZT() {
+    const byte *data = spiRx + 2;
+    x = (int16_t) (data[0] | (data[1] << 8));
+    y = (int16_t) (data[2] | (data[3] << 8));
+    z = (int16_t) (data[4] | (data[5] << 8));
+    t = (int16_t) (data[6] | (data[7] << 8));
+}
+
+void PhotonADXL362Accel::spiBurstComplete() {
+    PhotonADXL362Accel *accel = spiActive;
+    if (accel) {
+        digitalWrite(accel->pin, HIGH);
+        accel->sampleReady = true;
+        spiActive = NULL;
+    }
 }
 
 
@@ -640,15 +1872,105 @@ int noteToFrequency(const char *note_cstr, byte octave) {
 
 
 
+/*************************
+ * trig
+ */
+
+// sin(0..90 degrees) * 32767 in 64 steps, the other 3 quarters are mirrors of this one
+const int16_t bpb_sinQuarter[65] = {
+        0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+        6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+        12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+        18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+        23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+        27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+        30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+        32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+        32767,
+};
+
+int16_t sin16(uint16_t phase) {
+    uint16_t offset = (uint16_t) (phase & 0x3FFF);
+    if (phase & 0x4000) offset = (uint16_t) (0x4000 - offset);  // 2nd and 4th quarters run backwards
+    int idx = offset >> 8;
+    int16_t value = bpb_sinQuarter[idx];
+    if (idx < 64) value += ((bpb_sinQuarter[idx + 1] - value) * (offset & 0xFF)) >> 8;
+    return (phase & 0x8000) ? -value : value;
+}
+
+int16_t cos16(uint16_t phase) {
+    return sin16((uint16_t) (phase + 0x4000));
+}
+
+// atan(0..1) as a phase in 64 steps, the other octants are mirrors of this one
+const uint16_t bpb_atanOctant[65] = {
+        0, 163, 326, 489, 651, 813, 975, 1136,
+        1297, 1457, 1617, 1775, 1933, 2090, 2246, 2401,
+        2555, 2708, 2860, 3010, 3159, 3307, 3453, 3599,
+        3742, 3884, 4025, 4164, 4302, 4438, 4572, 4705,
+        4836, 4966, 5094, 5220, 5344, 5467, 5589, 5708,
+        5826, 5943, 6058, 6171, 6282, 6392, 6500, 6607,
+        6712, 6815, 6917, 7018, 7117, 7214, 7310, 7405,
+        7498, 7589, 7679, 7768, 7856, 7942, 8026, 8110,
+        8192,
+};
+
+uint16_t atan2_16(int32_t y, int32_t x) {
+    uint32_t ax = (uint32_t) (x < 0 ? -x : x);
+    uint32_t ay = (uint32_t) (y < 0 ? -y : y);
+    uint32_t num = min(ax, ay), den = max(ax, ay);
+    if (!den) return 0;
+    while (den >= 0x20000) { num >>= 1; den >>= 1; }  // keep num << 14 within 32 bits
+    uint32_t ratio = (num << 14) / den;  // 0..0x4000
+    uint32_t idx = ratio >> 8;
+    int32_t angle = bpb_atanOctant[idx];
+    if (idx < 64) angle += ((bpb_atanOctant[idx + 1] - angle) * (int32_t) (ratio & 0xFF)) >> 8;
+    if (ay > ax) angle = 0x4000 - angle;  // 2nd octant
+    if (x < 0) angle = 0x8000 - angle;  // left half
+    if (y < 0) angle = -angle;  // lower half
+    return (uint16_t) angle;
+}
+
+uint16_t hypot16(int32_t a, int32_t b) {
+    // bit by bit integer square root, 16 iterations of shifts and adds
+    uint32_t value = (uint32_t) (a * a) + (uint32_t) (b * b);
+    uint32_t root = 0;
+    for (uint32_t bit = 1UL << 30; bit; bit >>= 2) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return (uint16_t) root;
+}
+
+int8_t sin8(uint8_t phase) {
+    return (int8_t) (sin16((uint16_t) (phase << 8)) >> 8);
+}
+
+int8_t cos8(uint8_t phase) {
+    return (int8_t) (cos16((uint16_t) (phase << 8)) >> 8);
+}
+
+
+
 /*************************
  * palettes
  */
 
-PixelColor colorsBW[] = {PixelColor::WHITE, PixelColor::BLACK};  // white is first so that blink/fade animations work
-PixelColor colorsRGB[] = {PixelColor::R, PixelColor::G, PixelColor::B};
-PixelColor colorsRYGB[] = {PixelColor::RED, PixelColor::YELLOW, PixelColor::GREEN, PixelColor::BLUE};
-PixelColor colorsRYGBStripe[] = {PixelColor::RED, 0, PixelColor::YELLOW, 0, PixelColor::GREEN, 0, PixelColor::BLUE, 0 };
-PixelColor colorsRainbow[] = {PixelColor::RED, PixelColor::ORANGE, PixelColor::YELLOW, PixelColor::GREEN, PixelColor::BLUE, PixelColor::INDIGO, PixelColor::VIOLET};
+#define COLORS_BW PixelColor::WHITE, PixelColor::BLACK  // white is first so that blink/fade animations work
+#define COLORS_RGB PixelColor::R, PixelColor::G, PixelColor::B
+#define COLORS_RYGB PixelColor::RED, PixelColor::YELLOW, PixelColor::GREEN, PixelColor::BLUE
+#define COLORS_RYGB_STRIPE PixelColor::RED, 0, PixelColor::YELLOW, 0, PixelColor::GREEN, 0, PixelColor::BLUE, 0
+#define COLORS_RAINBOW PixelColor::RED, PixelColor::ORANGE, PixelColor::YELLOW, PixelColor::GREEN, PixelColor::BLUE, PixelColor::INDIGO, PixelColor::VIOLET
+
+PixelColor colorsBW[] = {COLORS_BW};
+PixelColor colorsRGB[] = {COLORS_RGB};
+PixelColor colorsRYGB[] = {COLORS_RYGB};
+PixelColor colorsRYGBStripe[] = {COLORS_RYGB_STRIPE};
+PixelColor colorsRainbow[] = {COLORS_RAINBOW};
 
 PixelPalette paletteBW = { 2, colorsBW };
 PixelPalette paletteRGB = { 3, colorsRGB };
@@ -657,47 +1979,132 @@ PixelPalette paletteRYGBStripe = { 8, colorsRYGBStripe };
 PixelPalette paletteRainbow = { 7, colorsRainbow };
 
 
+/*************************
+ * precomputed gradients (same result as PixelPalette::bake, built by the compiler)
+ */
+
+constexpr byte bpb_lerp(uint32_t from, uint32_t to, int shift, uint32_t fraction) {
+    return (byte) (((from >> shift) & 0xFF) +
+            ((((int32_t) ((to >> shift) & 0xFF) - (int32_t) ((from >> shift) & 0xFF)) * (int32_t) fraction) >> 16));
+}
+
+constexpr PixelColor bpb_gradientColor(const uint32_t *colors, uint32_t count, uint32_t first, uint32_t fraction) {
+    return PixelColor(bpb_lerp(colors[first], colors[(first + 1) % count], 16, fraction),
+                      bpb_lerp(colors[first], colors[(first + 1) % count], 8, fraction),
+                      bpb_lerp(colors[first], colors[(first + 1) % count], 0, fraction));
+}
+
+constexpr PixelColor bpb_gradientAt(const uint32_t *colors, uint32_t count, uint32_t idx) {
+    return bpb_gradientColor(colors, count, (uint32_t) (((uint64_t) idx * count << 16) / PIXEL_GRADIENT_SIZE) >> 16,
+                             (uint32_t) (((uint64_t) idx * count << 16) / PIXEL_GRADIENT_SIZE) & 0xFFFF);
+}
+
+constexpr uint32_t rgbBW[] = {COLORS_BW};
+constexpr uint32_t rgbRGB[] = {COLORS_RGB};
+constexpr uint32_t rgbRYGB[] = {COLORS_RYGB};
+constexpr uint32_t rgbRYGBStripe[] = {COLORS_RYGB_STRIPE};
+constexpr uint32_t rgbRainbow[] = {COLORS_RAINBOW};
+
+#define GRADIENT_BW(n) bpb_gradientAt(rgbBW, arraySize(rgbBW), n)
+#define GRADIENT_RGB(n) bpb_gradientAt(rgbRGB, arraySize(rgbRGB), n)
+#define GRADIENT_RYGB(n) bpb_gradientAt(rgbRYGB, arraySize(rgbRYGB), n)
+#define GRADIENT_RYGB_STRIPE(n) bpb_gradientAt(rgbRYGBStripe, arraySize(rgbRYGBStripe), n)
+#define GRADIENT_RAINBOW(n) bpb_gradientAt(rgbRainbow, arraySize(rgbRainbow), n)
+
+#define PIXEL_GRADIENT4(at, n) at(n), at(n + 1), at(n + 2), at(n + 3)
+#define PIXEL_GRADIENT16(at, n) PIXEL_GRADIENT4(at, n), PIXEL_GRADIENT4(at, n + 4), PIXEL_GRADIENT4(at, n + 8), PIXEL_GRADIENT4(at, n + 12)
+#define PIXEL_GRADIENT64(at, n) PIXEL_GRADIENT16(at, n), PIXEL_GRADIENT16(at, n + 16), PIXEL_GRADIENT16(at, n + 32), PIXEL_GRADIENT16(at, n + 48)
+#define PIXEL_GRADIENT256(at) PIXEL_GRADIENT64(at, 0), PIXEL_GRADIENT64(at, 64), PIXEL_GRADIENT64(at, 128), PIXEL_GRADIENT64(at, 192)
+
+const PixelColor gradientBW[PIXEL_GRADIENT_SIZE] = { PIXEL_GRADIENT256(GRADIENT_BW) };
+const PixelColor gradientRGB[PIXEL_GRADIENT_SIZE] = { PIXEL_GRADIENT256(GRADIENT_RGB) };
+const PixelColor gradientRYGB[PIXEL_GRADIENT_SIZE] = { PIXEL_GRADIENT256(GRADIENT_RYGB) };
+const PixelColor gradientRYGBStripe[PIXEL_GRADIENT_SIZE] = { PIXEL_GRADIENT256(GRADIENT_RYGB_STRIPE) };
+const PixelColor gradientRainbow[PIXEL_GRADIENT_SIZE] = { PIXEL_GRADIENT256(GRADIENT_RAINBOW) };
+
+
+
+/*************************
+ * blending
+ */
+
+void pixelBlend(PixelColor *dst, const PixelColor *src, int count, PixelLayer::Blend blend, byte alpha) {
+    uint32_t weight = alpha + (alpha >> 7);  // 0..256
+    for (int idx = 0; idx < count; idx++) {
+        uint32_t below = dst[idx].rgb();
+        uint32_t above = src[idx].rgb();
+        uint32_t result;
+        switch (blend) {
+            case PixelLayer::REPLACE:
+                result = above ? above : below;
+                break;
+            case PixelLayer::ADD: {
+                // add the low 7 bits of each channel so nothing carries into the next channel, then fix up bit 7
+                // and saturate the channels that carried out
+                uint32_t sum = ((below & 0x7F7F7F) + (above & 0x7F7F7F)) ^ ((below ^ above) & 0x808080);
+                uint32_t carry = ((below & above) | ((below ^ above) & ~sum)) & 0x808080;
+                result = sum | ((carry >> 7) * 0xFF);
+                break;
+            }
+            case PixelLayer::MULTIPLY:
+                // different multiplier per channel, this one has to be done a channel at a time
+                result = (((((below >> 16) & 0xFF) * (((above >> 16) & 0xFF) + 1)) >> 8) << 16) |
+                         (((((below >> 8) & 0xFF) * (((above >> 8) & 0xFF) + 1)) >> 8) << 8) |
+                         (((below & 0xFF) * ((above & 0xFF) + 1)) >> 8);
+                break;
+            case PixelLayer::ALPHA:
+            default:
+                // red and blue are 16 bits apart so both products fit in one 32 bit multiply, then green
+                result = ((((below & 0xFF00FF) * (256 - weight) + (above & 0xFF00FF) * weight) >> 8) & 0xFF00FF) |
+                         ((((below & 0x00FF00) * (256 - weight) + (above & 0x00FF00) * weight) >> 8) & 0x00FF00);
+                break;
+        }
+        dst[idx] = PixelColor(result);
+    }
+}
+
+
 
 /*************************
  * animations
  */
 
 void animation_blink(PixelAnimationData* data) {
-    data->setPixels(data->paletteColor(0).scale((data->step(2) + 1) % 2));
+    data->setPixels(data->paletteColor(0).scaleFixed((uint32_t) ((data->step(2) + 1) % 2) << 16));
 }
 
 void animation_alternating(PixelAnimationData* data) {
     int step = data->step(2);
     for (int idx = 0; idx < data->pixelCount; idx++) {
-        data->pixels[idx] = data->paletteColor(0).scale((step + idx) % 2);
+        data->pixels[idx] = data->paletteColor(0).scaleFixed((uint32_t) ((step + idx) % 2) << 16);
     }
 }
 
 void animation_fadeIn(PixelAnimationData* data) {
-    data->setPixels(data->paletteColor(0).scale(data->step(1.0f)));
+    data->setPixels(data->paletteColor(0).scaleFixed(data->stepFixed(1)));
 }
 
 void animation_fadeOut(PixelAnimationData* data) {
-    data->setPixels(data->paletteColor(0).scale(1.0f - data->step(1.0f)));
+    data->setPixels(data->paletteColor(0).scaleFixed(0x10000 - data->stepFixed(1)));
 }
 
 void animation_glow(PixelAnimationData* data) {
-    float scale = (-cosf(data->step((float)M_PI*2)) + 1.0f) / 2.0f;
-    data->setPixels(data->paletteColor(0).scale(scale));
+    // (1 - cos) / 2 as 16.16
+    data->setPixels(data->paletteColor(0).scaleFixed((uint32_t) (0x8000 - data->stepCos())));
 }
 
 void animation_strobe(PixelAnimationData* data) {
     int step = data->step(10);  // 1/10th of the cycle
     if (step != data->temp) {
         data->temp = step;
-        data->setPixels(data->randomColor().scale(step==0));
+        data->setPixels(data->randomColor().scaleFixed((uint32_t) (step == 0) << 16));
     }
 }
 
 void animation_sparkle(PixelAnimationData* data) {
     int step = (int) (data->cycleMillis / 10);
     for (int idx = 0; idx < data->pixelCount; idx++) {
-        data->pixels[idx] = (random(step) == 0) ? data->randomColor() : data->pixelColor(idx).scale(0.75);
+        data->pixels[idx] = (random(step) == 0) ? data->randomColor() : data->pixelColor(idx).scaleFixed(0xC000);  // 0.75
     }
 }
 
@@ -719,7 +2126,7 @@ void animation_increment(PixelAnimationData* data) {
     int pixStep = data->pixelStep();  
     PixelColor color = data->palettePartialStepColor();
     for (int idx = 0; idx < data->pixelCount; idx++) {
-        data->pixels[idx] = color.scale(idx == pixStep ? 1 : 0);
+        data->pixels[idx] = color.scaleFixed(idx == pixStep ? 0x10000 : 0);
     }
 }
 
@@ -727,7 +2134,7 @@ void animation_decrement(PixelAnimationData* data) {
     int pixStep = data->pixelStep();
     PixelColor color = data->palettePartialStepColor();
     for (int idx = 0; idx < data->pixelCount; idx++) {
-        data->pixels[idx] = color.scale(idx == (data->pixelCount - 1 - pixStep) ? 1 : 0);
+        data->pixels[idx] = color.scaleFixed(idx == (data->pixelCount - 1 - pixStep) ? 0x10000 : 0);
     }
 }
 
@@ -735,30 +2142,33 @@ void animation_bounce(PixelAnimationData* data) {
     int pixStep = data->step(2 * data->pixelCount - 2);
     PixelColor color = data->palettePartialStepColor();
     for (int idx = 0; idx < data->pixelCount; idx++) {
-        int scale = (idx == (-abs(pixStep - data->pixelCount + 1) + data->pixelCount - 1)) ? 1 : 0;
-        data->pixels[idx] = color.scale(scale);
+        int scale = (idx == (-abs(pixStep - data->pixelCount + 1) + data->pixelCount - 1)) ? 0x10000 : 0;
+        data->pixels[idx] = color.scaleFixed((uint32_t) scale);
     }
 }
 
 void animation_scanner(PixelAnimationData* data) {
-    float tail = data->pixelCount / 4;
-    float step = data->step(2 * data->pixelCount + ((tail * 4) - 1));
+    int tail = data->pixelCount / 4;
+    int32_t step = (int32_t) data->stepFixed(2 * data->pixelCount + ((tail * 4) - 1));
+    int head = abs((int) ((step - ((data->pixelCount + 2 * tail) << 16)) / 0x10000));  // truncate toward zero
     PixelColor color = data->palettePartialStepColor();
     for (int idx = 0; idx < data->pixelCount; idx++) {
-        float scale = constrain((-abs((int) (abs((int) (step - data->pixelCount - 2 * tail)) - idx - tail)) + tail), 0, 1);
-        data->pixels[idx] = color.scale(scale);
+        int scale = constrain(-abs(head - idx - tail) + tail, 0, 1);
+        data->pixels[idx] = color.scaleFixed((uint32_t) scale << 16);
     }
 }
 
 void animation_comet(PixelAnimationData* data) {
-    float tail = data->pixelCount / 2;
-    float pixStep = data->step(2 * data->pixelCount - tail);
+    int tail = max(data->pixelCount / 2, 1);
+    int32_t pixStep = (int32_t) data->stepFixed(2 * data->pixelCount - tail);
+    // palette steps per pixel behind the head: (paletteCount - 1) / (pixelCount / 1.75), 16.16
+    int32_t palettePerPixel = ((data->paletteCount() - 1) * 7 << 16) / (4 * data->pixelCount);
     PixelColor color;
     for (int idx = 0; idx < data->pixelCount; idx++) {
-        float palStep = data->mapFloat(max(pixStep - idx, 0), 0, (data->pixelCount / 1.75f), 0, data->paletteCount() - 1);
-        color = data->paletteColor(palStep);
-        float scale = constrain((((idx - pixStep) / tail + 1.25f)) * (((idx - pixStep) < 0) ? 1 : 0), 0, 1);
-        data->pixels[idx] = color.scale(scale);
+        int32_t behind = pixStep - (idx << 16);
+        color = data->paletteColorFixed((uint32_t) ((int64_t) max(behind, 0) * palettePerPixel >> 16));
+        int32_t scale = behind > 0 ? constrain(0x14000 - behind / tail, 0, 0x10000) : 0;  // 1.25 - behind/tail
+        data->pixels[idx] = color.scaleFixed((uint32_t) scale);
     }
 }
 
@@ -770,9 +2180,12 @@ void animation_bars(PixelAnimationData* data) {
 }
 
 void animation_gradient(PixelAnimationData* data) {
-    float step = data->pixelStep();
+    int step = data->pixelStep();
     for (int idx = 0; idx < data->pixelCount; idx++) {
-        data->pixels[idx] = data->paletteColor((step + idx) * data->paletteCount() / data->pixelCount);
+        // (step + idx) * paletteCount / pixelCount as 16.16, whole part and remainder kept apart to avoid overflow
+        uint32_t index = (uint32_t) (step + idx) * data->paletteCount();
+        uint32_t whole = index / data->pixelCount;
+        uint32_t part = ((index - whole * data->pixelCount) << 16) / data->pixelCount;
+        data->pixels[idx] = data->paletteColorFixed((whole << 16) | part);
     }
 }
-
@@ -26,6 +26,14 @@ limitations under the License.
 #define BUTTON_3_PHOTON_PIN 6
 #define BUTTON_4_PHOTON_PIN 7
 #define BUTTON_DEBOUNCE_DELAY 50  // 50ms button press/release debounce
+#define BUTTON_SAMPLE_TIME (BUTTON_DEBOUNCE_DELAY / 4)  // a change has to hold for 4 samples (12ms apart)
+#define BUTTON_LONG_PRESS 800  // ms held before a GESTURE_LONG_PRESS
+#define BUTTON_DOUBLE_CLICK 300  // ms after a click for a second click to make it a GESTURE_DOUBLE_CLICK
+#define BUTTON_REPEAT 150  // ms between GESTURE_REPEATs while held after a long press
+#ifndef GESTURE_MAX_BUTTONS
+#define GESTURE_MAX_BUTTONS BUTTON_COUNT  // buttons a ButtonGestures tracks (up to 32)
+#endif
+#define BUTTON_QUEUE_SIZE 16  // button edges captured by interrupt between update()s, must be a power of 2
 
 #define BUZZER_PHOTON_PIN D0
 #define DEFAULT_BPM 120  // 1/2 second quarter note
@@ -35,8 +43,37 @@ limitations under the License.
 #define PIXEL_PHOTON_PIN 3
 #define PIXEL_COUNT 11  // Particle InternetButton 11 LED ring
 
+#define PIXEL_LAYER_COUNT 4  // animation layers composited over the main animation
+
+#define PIXEL_GRADIENT_SIZE 256  // entries in the built in precomputed palette gradients (768 bytes of flash each)
+
+#define PIXEL_SPI_CLOCK 3750000  // 267ns per SPI bit, each WS2812 bit is sent as 4 SPI bits (1.07us)
+#define PIXEL_SPI_BYTES_PER_PIXEL 12  // 24 WS2812 bits * 4 SPI bits / 8
+#define PIXEL_SPI_RESET_BYTES 24  // 51us of low output at PIXEL_SPI_CLOCK, latches the frame
+#define PIXEL_SPI_BUFFER_SIZE(count) ((count) * PIXEL_SPI_BYTES_PER_PIXEL + PIXEL_SPI_RESET_BYTES)
+
 #define ADXL_PHOTON_PIN A2
 #define ADXL_TOLERANCE 10  // 10 raw units of +/- tolerance on x/y/z before detecting movement
+#define ADXL_INACTIVE_TIME 1000  // ms within the tolerance before the sensor's activity detection reports no motion
+#define ADXL_STILL_AFTER 5000  // ms not in motion before an adaptive rate slows down
+
+#define DEADLINE_NONE 0xFFFFFFFFUL  // nothing scheduled
+
+/* integer sine/cosine, phase 0..0xFFFF is one full circle (0x4000 = 90 degrees), returns -32767..32767 */
+#define SIN16_MAX_ERROR 4  // most sin16/cos16 differ from 32767 * sin(), 0.012% (65 entry table, interpolated)
+extern int16_t sin16(uint16_t phase);
+extern int16_t cos16(uint16_t phase);
+
+/* integer atan2, the angle of (x, y) as a phase (0x4000 = 90 degrees, 0x8000 = 180), 0 for (0, 0) */
+extern uint16_t atan2_16(int32_t y, int32_t x);
+
+/* integer sqrt(a^2 + b^2), a and b within +-32767 */
+extern uint16_t hypot16(int32_t a, int32_t b);
+
+/* integer sine/cosine, phase 0..0xFF is one full circle (0x40 = 90 degrees), returns -128..127 (sin16 >> 8) */
+#define SIN8_MAX_ERROR 2  // most sin8/cos8 differ from 127 * sin()
+extern int8_t sin8(uint8_t phase);
+extern int8_t cos8(uint8_t phase);
 
 /* holds a color, some helper functions for manipulating the color */
 struct PixelColor {
@@ -47,11 +84,11 @@ struct PixelColor {
     inline PixelColor() __attribute__((always_inline)) { }
 
     /* create a color with the given red, green, and blue values */
-    inline PixelColor(byte red, byte green, byte blue)  __attribute__((always_inline))
+    inline constexpr PixelColor(byte red, byte green, byte blue)  __attribute__((always_inline))
             : r(red), g(green), b(blue) { }
 
     /* create a color with the given 0xRRGGBB value */
-    inline PixelColor(uint32_t rgb)  __attribute__((always_inline))
+    inline constexpr PixelColor(uint32_t rgb)  __attribute__((always_inline))
             : r((byte) ((rgb >> 16) & 0xFF)), g((byte) ((rgb >> 8) & 0xFF)), b((byte) ((rgb >> 0) & 0xFF)) { }
 
     bool operator == (const PixelColor &other) const {
@@ -63,7 +100,7 @@ struct PixelColor {
     }
 
     /* return the current color as 0xRRGGBB */
-    uint32_t rgb() { return ((uint32_t)r << 16) | ((uint32_t)g <<  8) | b; }
+    uint32_t rgb() const { return ((uint32_t)r << 16) | ((uint32_t)g <<  8) | b; }
 
     /* compute a new color between the current one and given one using the given fractional value */
     PixelColor interpolate(PixelColor color, float value) {
@@ -79,6 +116,20 @@ struct PixelColor {
                           (byte) min(b * value, 0xFF));
     }
 
+    /* interpolate using a 0.16 fixed point fraction (0x8000 = 0.5), no floating point */
+    PixelColor interpolateFixed(PixelColor color, uint16_t fraction) {
+        return PixelColor((byte) (r + (((int32_t) (color.r - r) * fraction) >> 16)),
+                          (byte) (g + (((int32_t) (color.g - g) * fraction) >> 16)),
+                          (byte) (b + (((int32_t) (color.b - b) * fraction) >> 16)));
+    }
+
+    /* scale using a 16.16 fixed point value (0x10000 = 1.0, up to 256.0), no floating point */
+    PixelColor scaleFixed(uint32_t value) {
+        return PixelColor((byte) min((r * value) >> 16, 0xFFu),
+                          (byte) min((g * value) >> 16, 0xFFu),
+                          (byte) min((b * value) >> 16, 0xFFu));
+    }
+
     enum Colors: uint32_t {
         OFF     = 0,
         BLACK   = OFF,
@@ -124,15 +175,48 @@ struct PixelColor {
 struct PixelPalette {
     byte count;
     PixelColor *colors;
+    const PixelColor *gradient = NULL;  // optional precomputed gradient, see bake() and useGradient()
+    PixelColor *gradientPending = NULL;  // bake() table waiting to be filled on first use
+    uint16_t gradientMask = 0;
+    uint32_t gradientScale = 0;
+
+    /* create a palette of the given colors, e.g. { 3, colorsRGB }, interpolated between them until baked */
+    inline constexpr PixelPalette(byte count = 0, PixelColor *colors = NULL) : count(count), colors(colors) { }
 
     /* return a color at the given index, if the index is fractional compute the proper color between the two indices */
     PixelColor computeColorAt(float index) {
+        if (gradient || gradientPending) return computeColorAtFixed((uint32_t) (index * 0x10000));
         int first = (int) index % (count);
         int second = (int) (index + 1) % (count);
         float interpolationValue = index - (int) index;
         return colors[first].interpolate(colors[second], interpolationValue);
     }
 
+    /* like computeColorAt(float) with a 16.16 fixed point index (0x18000 = 1.5) */
+    PixelColor computeColorAtFixed(uint32_t index) {
+        if (gradientPending) bakeGradient();
+        if (gradient) return gradient[(uint32_t) (((uint64_t) index * gradientScale) >> 32) & gradientMask];
+        int first = (int) (index >> 16) % count;
+        int second = (first + 1) % count;
+        return colors[first].interpolateFixed(colors[second], (uint16_t) index);
+    }
+
+    /* expand the palette into the given table of size (power of 2) colors the first time a color is computed,
+     * after that computeColorAt() is a single table lookup; RAM cost is 3 * size bytes (768 for 256) */
+    void bake(PixelColor *table, uint16_t size) {
+        useGradient(NULL, size);
+        gradientPending = table;
+    }
+
+    /* use an already computed gradient table of size (power of 2) colors, e.g. gradientRainbow (flash),
+     * or NULL to go back to interpolating between the colors */
+    void useGradient(const PixelColor *table, uint16_t size) {
+        gradient = table;
+        gradientPending = NULL;
+        gradientMask = (uint16_t) (size - 1);
+        gradientScale = (uint32_t) ((((uint64_t) size << 16) + count - 1) / count);  // table entries per palette index
+    }
+
     /* return one of the palette colors randomly */
     PixelColor randomColor() {
         return colors[random(count)];
@@ -145,6 +229,16 @@ struct PixelPalette {
         }
         return true;
     }
+
+private:
+    void bakeGradient() {
+        PixelColor *table = gradientPending;
+        gradientPending = NULL;
+        for (uint32_t idx = 0; idx <= gradientMask; idx++) {
+            table[idx] = computeColorAtFixed((uint32_t) (((uint64_t) idx * count << 16) / (gradientMask + 1)));
+        }
+        gradient = table;
+    }
 };
 
 extern PixelPalette paletteBW;
@@ -153,6 +247,13 @@ extern PixelPalette paletteRYGB;
 extern PixelPalette paletteRYGBStripe;
 extern PixelPalette paletteRainbow;
 
+/* the built in palettes as precomputed gradients, for use with PixelPalette::useGradient */
+extern const PixelColor gradientBW[PIXEL_GRADIENT_SIZE];
+extern const PixelColor gradientRGB[PIXEL_GRADIENT_SIZE];
+extern const PixelColor gradientRYGB[PIXEL_GRADIENT_SIZE];
+extern const PixelColor gradientRYGBStripe[PIXEL_GRADIENT_SIZE];
+extern const PixelColor gradientRainbow[PIXEL_GRADIENT_SIZE];
+
 /* holds the data and functions given to a PixelAnimation function */
 struct PixelAnimationData {
     int pixelCount;
@@ -170,6 +271,19 @@ struct PixelAnimationData {
     /* return the current fractional step, given the number of steps, based on time and cycle time */
     float step(float steps) { return ((updated - start) % cycleMillis) * steps / cycleMillis; }
 
+    /* return the current fractional step as 16.16 fixed point (0x10000 = 1 step) */
+    uint32_t stepFixed(int steps) {
+        return (uint32_t) (((uint64_t) ((updated - start) % cycleMillis) * steps << 16) / cycleMillis);
+    }
+
+    /* return the current position in the cycle as a 16 bit phase (0x10000 = the whole cycle, 2*PI) */
+    inline uint16_t stepPhase() { return (uint16_t) stepFixed(1); }
+
+    /* return the sine/cosine of the current phase, -32767..32767 */
+    inline int16_t stepSin() { return sin16(stepPhase()); }
+
+    inline int16_t stepCos() { return cos16(stepPhase()); }
+
     /* return the size of the color palatte */
     inline int paletteCount() { return palette->count; }
 
@@ -182,12 +296,17 @@ struct PixelAnimationData {
     /* return the current step as fractional palatte index */
     inline float palettePartialStep() { return step((float)palette->count); }
 
-    inline PixelColor paletteStepColor() { return palette->computeColorAt(paletteStep()); }
+    /* return the current step as 16.16 fixed point palette index */
+    inline uint32_t palettePartialStepFixed() { return stepFixed(palette->count); }
+
+    inline PixelColor paletteStepColor() { return paletteColor(paletteStep()); }
 
-    inline PixelColor palettePartialStepColor() { return palette->computeColorAt(palettePartialStep()); }
+    inline PixelColor palettePartialStepColor() { return palette->computeColorAtFixed(palettePartialStepFixed()); }
 
     inline PixelColor paletteColor(float index) { return palette->computeColorAt(index); }
 
+    inline PixelColor paletteColorFixed(uint32_t index) { return palette->computeColorAtFixed(index); }
+
     inline PixelColor paletteColor(int index) { return palette->colors[index % palette->count]; }
 
     inline PixelColor randomColor() { return palette->randomColor(); }
@@ -199,6 +318,11 @@ struct PixelAnimationData {
     float mapFloat(float value, float minLeft, float maxLeft, float minRight, float maxRight) {
         return (value - minLeft) * (maxRight - minRight) / (maxLeft - minLeft) + minRight;
     }
+
+    /* integer mapFloat, works for any fixed point format as long as all the values use the same one */
+    int32_t mapFixed(int32_t value, int32_t minLeft, int32_t maxLeft, int32_t minRight, int32_t maxRight) {
+        return (int32_t) ((int64_t) (value - minLeft) * (maxRight - minRight) / (maxLeft - minLeft)) + minRight;
+    }
 };
 
 /* function definition for creating animations */
@@ -227,9 +351,160 @@ extern PixelAnimation animation_gradient;
 
 
 
+/* an animation composited over the pixels, see BetterPhotonButton::startPixelLayer */
+struct PixelLayer {
+    /* REPLACE: non-black layer pixels replace the pixels below, ADD: saturating add,
+     * MULTIPLY: multiply channels (black darkens, white keeps), ALPHA: mix by the layer's alpha */
+    enum Blend: byte { REPLACE, ADD, MULTIPLY, ALPHA };
+
+    PixelAnimation *animation;
+    PixelAnimationData data;
+    int refresh;
+    Blend blend;
+    byte alpha;  // 255 = only the layer
+};
+
+/* blend count colors from src into dst, working on whole 0xRRGGBB words rather than one channel at a time */
+extern void pixelBlend(PixelColor *dst, const PixelColor *src, int count, PixelLayer::Blend blend, byte alpha = 255);
+
+
 /**********************************************************************************************************************/
 
+// build everything (library and application) with -DBETTERPHOTONBUTTON_PROFILE to time each stage of update()
+#ifdef BETTERPHOTONBUTTON_PROFILE
+#define PROFILE_HISTOGRAM_BINS 8  // stage times in us: <1, <4, <16, <64, <256, <1024, <4096, >=4096
+
+/* the stages of BetterPhotonButton::update(), UPDATE is all of them and INTERVAL the time between update() calls */
+enum ProfileStageId: byte {
+    PROFILE_NOTES, PROFILE_ANIMATION, PROFILE_LAYERS, PROFILE_COMPOSE, PROFILE_PIXELS, PROFILE_ACCEL, PROFILE_BUTTONS,
+    PROFILE_UPDATE, PROFILE_INTERVAL, PROFILE_STAGES
+};
+
+/* timing of one stage, in ns */
+struct ProfileStage {
+    unsigned long count;
+    uint64_t total;
+    uint32_t min;
+    uint32_t max;
+    unsigned long histogram[PROFILE_HISTOGRAM_BINS];
+
+    void record(uint32_t nanos) {
+        if (!count || nanos < min) min = nanos;
+        if (nanos > max) max = nanos;
+        count++;
+        total += nanos;
+        uint32_t micros = nanos / 1000;
+        byte bin = 0;
+        while (micros && bin < PROFILE_HISTOGRAM_BINS - 1) { micros >>= 2; bin++; }
+        histogram[bin]++;
+    }
+
+    uint32_t mean() { return count ? (uint32_t) (total / count) : 0; }
+
+    /* spread of the times, for PROFILE_INTERVAL the loop jitter */
+    uint32_t jitter() { return count ? max - min : 0; }
+};
+#endif
+
+/* debounces up to 32 buttons at once, a bit per button, with 2 bit vertical counters (bit n of count0/count1 is
+ * button n's counter): a button changes state once its raw level has differed for 4 samples in a row */
+struct ButtonDebouncer {
+    uint32_t state;  // debounced levels, 1 = pressed
+    uint32_t raw;  // levels from the last sample
+    uint32_t count0;
+    uint32_t count1;
+
+    /* feed the raw levels, returns a mask of the buttons whose debounced state changed */
+    uint32_t sample(uint32_t levels) {
+        raw = levels;
+        uint32_t delta = levels ^ state;
+        uint32_t changed = delta & count0 & count1;  // 4th sample in a row that differs
+        count1 = (count1 ^ count0) & delta;  // count up where different, back to 0 where not
+        count0 = ~count0 & delta;
+        state ^= changed;
+        return changed;
+    }
+
+    /* true while a button's raw level differs from its debounced state */
+    bool pending() { return raw != state; }
+};
+
+enum GestureType: byte {
+    GESTURE_CLICK,  // pressed and released (after BUTTON_DOUBLE_CLICK without a second press)
+    GESTURE_DOUBLE_CLICK,  // clicked twice within BUTTON_DOUBLE_CLICK
+    GESTURE_LONG_PRESS,  // held for BUTTON_LONG_PRESS
+    GESTURE_REPEAT,  // still held after a long press, every BUTTON_REPEAT
+    GESTURE_CHORD  // two or more buttons held together, again each time another joins
+};
+
+struct ButtonGesture {
+    GestureType type;
+    byte button;  // the button, for a chord the one that completed it
+    uint32_t buttons;  // bit per button involved
+    byte repeats;  // GESTURE_REPEATs so far
+    unsigned long held;  // ms since the (first) press
+    unsigned long micros;  // micros() of the (first) press
+};
+
+/* function definition for gesture callbacks */
+typedef void (GestureHandler)(ButtonGesture *gesture);
+
+/* recognizes gestures from debounced button edges with a state table per button, no allocations */
+class ButtonGestures {
+public:
+    ButtonGestures();
+
+    void setHandler(GestureHandler *handler);
+
+    /* in ms, 0 turns long presses (and so repeats) / repeats off, or reports clicks without waiting for a double */
+    void setTiming(unsigned int longPress, unsigned int doubleClick, unsigned int repeat);
+
+    /* a debounced press or release */
+    void edge(byte button, bool pressed, system_tick_t millis, unsigned long micros);
+
+    /* report the gestures whose time has come */
+    void update(system_tick_t millis);
+
+    /* the millis of the next timed gesture, DEADLINE_NONE if none */
+    system_tick_t nextDeadline();
+
+private:
+    enum State: byte { IDLE, DOWN, HELD, CLICKED, DOWN_AGAIN, CHORDED, STATES };
+    enum Input: byte { PRESS, RELEASE, TIMEOUT, INPUTS };
+
+    struct Transition {
+        State next;
+        int8_t gesture;  // GestureType to report, -1 = none
+    };
+
+    struct Button {
+        State state;
+        byte repeats;
+        system_tick_t pressed;
+        system_tick_t deadline;
+        unsigned long micros;
+    };
+
+    static const Transition transitions[STATES][INPUTS];
+
+    void input(byte button, Input input, system_tick_t millis);
+
+    int32_t timeout(State state);  // -1 = none
+
+    void report(GestureType type, byte button, uint32_t buttons, system_tick_t millis);
+
+    Button buttons[GESTURE_MAX_BUTTONS];
+    uint32_t down;
+    uint32_t timed;  // buttons with a deadline
+    unsigned int longPress;
+    unsigned int doubleClick;
+    unsigned int repeat;
+    GestureHandler *handler;
+};
+
 class PhotonADXL362Accel;
+class PhotonWS2812Pixel;
+struct AccelFilter;
 
 typedef void (ButtonHandler)(int button, bool pressed);
 extern int noteToFrequency(const char *note_cstr, byte octave = DEFAULT_OCTAVE);
@@ -243,7 +518,13 @@ public:
     void setup(void);
 
     // update all the things (pixels, buttons, accelermeter, buzzer), call this from the application's loop()
-    void update(system_tick_t millis);
+    // returns nextDeadline(millis)
+    system_tick_t update(system_tick_t millis);
+
+    // milliseconds from millis until update() next has work to do (0 = now), the application can sleep or do
+    // other work until then, at most BUTTON_SAMPLE_TIME when buttons are polled, DEADLINE_NONE if nothing is
+    // scheduled and button interrupts are on
+    system_tick_t nextDeadline(system_tick_t millis);
 
     /* buttons */
 
@@ -265,6 +546,19 @@ public:
     // set the callback function for when the given button (0 based) is pressed
     void setReleasedHandler(byte button, ButtonHandler *handler);
 
+    // capture button edges with pin interrupts (timestamped to the microsecond) instead of reading the buttons on
+    // every update(), so no presses are missed during long updates and idle buttons cost nothing, call after setup()
+    void setButtonInterrupts(bool enabled);
+
+    // micros() when the given button's last debounced press/release started (the edge, not when it was handled)
+    unsigned long getButtonMicros(byte button);
+
+    // set the callback function for clicks, double clicks, long presses, auto repeats and chords
+    void setGestureHandler(GestureHandler *handler);
+
+    // change the gesture timing in ms (see BUTTON_LONG_PRESS, BUTTON_DOUBLE_CLICK, BUTTON_REPEAT)
+    void setGestureTiming(unsigned int longPress, unsigned int doubleClick, unsigned int repeat);
+
     /* pixels */
 
     // set given pixel (0 based) to given rgb colors, refreshes pixels on next update()
@@ -294,6 +588,15 @@ public:
     // retrieve the given pixel's color
     PixelColor getPixel(int pixel);
 
+    // scale the brightness of all pixels on output (255 = full), animations don't need to scale their colors
+    void setBrightness(byte brightness);
+
+    // gamma correct all pixels on output, makes dim colors usable
+    void setGamma(bool gamma);
+
+    // direct access to the pixel ring driver (frame counters, transmit settings)
+    PhotonWS2812Pixel* getPixelRing();
+
     /* animation */
 
     // start a pixel animation using the given animation function
@@ -306,10 +609,23 @@ public:
     // display the &animation_gradient and &palette_rainbow with the given cycle times and duration, -1=indefinite
     void rainbow(long cycle = 1000, long duration = -1);
 
+    // start an animation on one of the PIXEL_LAYER_COUNT layers, layers are drawn in order over the main pixels
+    PixelAnimationData* startPixelLayer(byte layer, PixelAnimation *animation,
+                                        PixelLayer::Blend blend = PixelLayer::ADD, byte alpha = 255,
+                                        PixelPalette *palette = &paletteRainbow,
+                                        long cycle = 1000, long duration = -1, int refresh = 1000/60);
+
+    // stop the animation on the given layer and remove it from the pixels
+    void stopPixelLayer(byte layer);
+
+    // true if the given layer has an animation running
+    bool isPixelLayerActive(byte layer);
+
     /* accelerometer */
 
-    /* initiate the accelerometer, set it update at the given refresh rate, and return pointer to it */
-    PhotonADXL362Accel* startAccelerometer(unsigned int refreshRate = 1000/10);
+    /* initiate the accelerometer, set it update at the given refresh rate, and return pointer to it,
+     * filter smooths the samples for getFilteredX/Y/Z() and the orientation (NULL = 50/50 between the last two) */
+    PhotonADXL362Accel* startAccelerometer(unsigned int refreshRate = 1000/10, AccelFilter *filter = NULL);
 
     /* buzzer */
 
@@ -324,13 +640,35 @@ public:
 
     void stopPlayingNotes();
 
+#ifdef BETTERPHOTONBUTTON_PROFILE
+    /* profiling */
+
+    // timing of the given stage of update() since the start or the last resetProfile()
+    const ProfileStage *getProfile(ProfileStageId stage);
+
+    void resetProfile();
+
+    // print the stages as CSV (stage,count,mean_ns,min_ns,max_ns,then the histogram bins)
+    void printProfile(Print &out = Serial);
+#endif
+
 private:
     void updateButtonsState(system_tick_t millis);
 
-    void updateButtonState(byte button, system_tick_t millis);
+    void updateButtonEvents();
+
+    uint32_t readButtons();
+
+    void setButtonLevels(uint32_t levels, unsigned long micros);
+
+    bool buttonInterrupts;
 
     void updateAnimation(system_tick_t millis);
 
+    void updateLayers(system_tick_t millis);
+
+    void composePixels();
+
     void updatePlayNotes(system_tick_t millis);
 
     void changeNoteSettings(char *current);
@@ -339,6 +677,16 @@ private:
     PixelAnimationData animationData = PixelAnimationData();
     int animationRefresh;
 
+    PixelLayer layers[PIXEL_LAYER_COUNT];
+    bool pixelsChanged;
+
+#ifdef BETTERPHOTONBUTTON_PROFILE
+    uint32_t profileRecord(ProfileStageId stage, uint32_t since);
+
+    ProfileStage profile[PROFILE_STAGES];
+    uint32_t profileLastUpdate;
+#endif
+
     String notesToPlay;
     char *noteCurrent;
     byte noteOctave;
@@ -353,42 +701,424 @@ private:
 
 
 
+class PhotonWS2812Pixel;
+
+/* encode pixels into WS2812 SPI line code (GRB wire order), buffer must hold count * PIXEL_SPI_BYTES_PER_PIXEL bytes */
+extern void ws2812Encode(const PixelColor *pixels, int count, byte *buffer);
+
+/* function definition for SPI/DMA transmit completion (called from the DMA interrupt) */
+typedef void (PixelTransmitHandler)(PhotonWS2812Pixel *pixel);
+
 // Photon Only, WS2812B Only
 class PhotonWS2812Pixel {
 public:
-    PhotonWS2812Pixel(PixelColor *pixels, int pixelCount, byte pin);
+    /* frame (optional, pixelCount * 3 bytes) holds the color order/brightness/gamma adjusted bytes so that work is
+     * done before interrupts are disabled; without it (and without SPI) only the color order is applied, brightness
+     * and gamma are ignored so the bit-bang loop doesn't get any slower */
+    PhotonWS2812Pixel(PixelColor *pixels, int pixelCount, byte pin, byte *frame = NULL);
 
     ~PhotonWS2812Pixel();
 
     void setup(void);
 
+    /* send the pixels out over the given SPI's MOSI pin using DMA instead of bit-banging with interrupts disabled,
+     * buffer must hold PIXEL_SPI_BUFFER_SIZE(pixelCount) bytes, the handler is called when each frame is sent
+     * (SPI = A5, SPI1 = D2; do not share the SPI with the accelerometer while a frame is being sent); false and
+     * the strip keeps bit-banging if its pin isn't that MOSI pin, e.g. the InternetButton ring on D3 can't use it */
+    bool setupSPI(SPIClass *spi, byte *buffer, PixelTransmitHandler *handler = NULL);
+
     void update(bool refresh = false) __attribute__((optimize("Ofast")));
 
     void triggerRefresh();
 
+    /* true while an SPI/DMA frame is being sent */
+    bool isTransmitting();
+
+    /* the order the pixels expect the color bytes in, WS2812B is GRB */
+    enum ColorOrder: byte { GRB, RGB, BRG, RBG, GBR, BGR };
+
+    void setColorOrder(ColorOrder order);
+
+    /* scale all colors on output, 255 = full brightness (bit-bang needs a frame buffer for this and gamma) */
+    void setBrightness(byte brightness);
+
+    byte getBrightness();
+
+    /* apply a gamma 2.8 curve on output so dim levels are usable */
+    void setGamma(bool gamma);
+
+    /* number of frames sent to the pixels */
+    unsigned long getFramesSent();
+
+    /* number of refreshes skipped because the frame was identical to the last one sent (update(true) never is) */
+    unsigned long getFramesSkipped();
+
     void setPixelColor(int pixel, PixelColor pixelColor);
 
+    /* bit-bang at most this many microseconds (rounded down to whole ~30us pixels, at least one) with interrupts
+     * disabled before letting pending interrupts run, 0 = the whole frame (default); resets getMaxInterruptOff() */
+    void setMaxInterruptOff(unsigned int window);
+
+    /* longest time in microseconds interrupts were disabled by update(), i.e. the worst interrupt latency it adds */
+    unsigned long getMaxInterruptOff();
+
+    /* frames started over because interrupts between pixels ran long enough for the pixels to latch */
+    unsigned long getFramesRestarted();
+
+    /* frames left for the next update() after being restarted 3 times, a frame is never sent
+     * with interrupts disabled for longer than the setMaxInterruptOff() window */
+    unsigned long getFramesDeferred();
+
+protected:
+    /* the pin's GPIO set/reset registers, looked up from the HAL pin map on first update if not set */
+    void setPinRegisters(volatile uint16_t *set, volatile uint16_t *reset, uint16_t mask);
+
+    /* bit-bang the frame with interrupts disabled, the pin's GPIO port and mask are constants in the bit loop (the
+     * Photon pins are instantiated) or with Port 0 the registers above are used; false if the frame was deferred */
+    template<uint32_t Port, uint16_t Mask>
+    bool sendFrame() __attribute__((optimize("Ofast")));
+
+    bool (PhotonWS2812Pixel::*sendBits)();  // the sendFrame() update() uses
+
 private:
+    void encodeSPI();
+
+    void transmitSPI(uint32_t hash);
+
+    uint32_t frameHash();
+
+    inline byte level(byte value);
+
+    inline uint32_t orderedColor(const PixelColor &color);
+
+    void prepareFrame();
+
+    void resolvePin();
+
+    static void spiTransmitComplete();
+
+    static PhotonWS2812Pixel * volatile spiActive;  // one DMA frame in flight at a time
+
     byte pin;
     PixelColor *pixels;
     int pixelCount;
     unsigned long endTime;
     bool refresh;
+    bool forceRefresh;  // update(true), sent even if it's the frame the pixels already show
+
+    volatile uint16_t *pinSet;
+    volatile uint16_t *pinReset;
+    uint16_t pinMask;
+
+    int chunkPixels;
+    uint32_t maxIrqOffTicks;
+    unsigned long framesRestarted;
+    unsigned long framesDeferred;
+
+    byte *frame;
+    byte order[3];  // offsets of the r, g, b bytes in a PixelColor in wire order
+    byte brightness;
+    bool gamma;
+
+    uint32_t sentHash;
+    unsigned long framesSent;
+    unsigned long framesSkipped;
+
+    SPIClass *spi;
+    byte *spiBuffer;
+    PixelTransmitHandler *transmitHandler;
+
+    friend class PhotonWS2812Parallel;
+};
+
+
+
+/* Photon pin (D0..D7, A0..A7, RX, TX) -> STM32F205 GPIO port base address and pin mask, same as the HAL pin map */
+constexpr uint32_t ws2812PinPorts[] = {
+        0x40020400, 0x40020400, 0x40020400, 0x40020400, 0x40020400, 0x40020000, 0x40020000, 0x40020000,  // D0..D7
+        0, 0,
+        0x40020800, 0x40020800, 0x40020800, 0x40020000, 0x40020000, 0x40020000, 0x40020000, 0x40020000,  // A0..A7
+        0x40020000, 0x40020000,  // RX, TX
 };
+constexpr uint16_t ws2812PinMasks[] = {
+        1 << 7, 1 << 6, 1 << 5, 1 << 4, 1 << 3, 1 << 15, 1 << 14, 1 << 13,
+        0, 0,
+        1 << 5, 1 << 3, 1 << 2, 1 << 5, 1 << 6, 1 << 7, 1 << 4, 1 << 0,
+        1 << 10, 1 << 9,
+};
+#define WS2812_BSRRL_OFFSET 0x18
+#define WS2812_BSRRH_OFFSET 0x1A
+
+/* a PhotonWS2812Pixel that holds its own N pixels (and frame buffer) on the given pin, with the pin's GPIO registers
+ * resolved at compile time, e.g. 'PhotonWS2812Strip<60, D2> strip;' then set strip.pixels[...] and call update() */
+template<uint16_t N, uint8_t Pin>
+class PhotonWS2812Strip : public PhotonWS2812Pixel {
+public:
+    static_assert(Pin < arraySize(ws2812PinPorts) && ws2812PinPorts[Pin], "PhotonWS2812Strip needs a Photon GPIO pin");
+
+    PhotonWS2812Strip() : PhotonWS2812Pixel(pixels, N, Pin, frame) {
+        // PixelColor() leaves the color as is, a strip on the stack or in an object would start with garbage
+        for (int idx = 0; idx < N; idx++) pixels[idx] = PixelColor(0);
+#if defined(__arm__)  // the host build resolves them from its simulated pin map on first update
+        setPinRegisters((volatile uint16_t *) (ws2812PinPorts[Pin] + WS2812_BSRRL_OFFSET),
+                        (volatile uint16_t *) (ws2812PinPorts[Pin] + WS2812_BSRRH_OFFSET),
+                        ws2812PinMasks[Pin]);
+        sendBits = &PhotonWS2812Strip::template sendFrame<ws2812PinPorts[Pin], ws2812PinMasks[Pin]>;
+#endif
+    }
 
+    PixelColor pixels[N];
+
+private:
+    byte frame[N * 3];
+};
+
+
+#define PIXEL_PARALLEL_MAX_STRIPS 16
+#define PIXEL_PARALLEL_BUFFER_SIZE(count) ((count) * 24)  // uint16_t bit slots for the longest strip's pixelCount
+
+/* transpose an 8x8 bit matrix of 8 lanes' bytes: bit i of out[k] is bit (7 - k) of in[i] */
+extern void ws2812Transpose8(const byte in[8], byte out[8]);
+
+/* sends the frames of up to PIXEL_PARALLEL_MAX_STRIPS strips at the same time, so 8 strips take as long with
+ * interrupts disabled as one does.  All the strips' pins must be on the same GPIO port (D0..D4 are on GPIOB,
+ * D5..D7, A3..A7, RX and TX on GPIOA) and each strip needs a frame buffer (PhotonWS2812Strip has one).
+ * slots must hold PIXEL_PARALLEL_BUFFER_SIZE(pixelCount) entries, shorter strips are padded with black */
+class PhotonWS2812Parallel {
+public:
+    PhotonWS2812Parallel(uint16_t *slots, int pixelCount);
+
+    /* false if the strip is longer than pixelCount, has no frame buffer, or isn't on the same port as the others */
+    bool addStrip(PhotonWS2812Pixel *strip);
+
+    void setup(void);
+
+    /* sends all the strips if any of them needs a refresh (or refresh is true) */
+    void update(bool refresh = false) __attribute__((optimize("Ofast")));
+
+    unsigned long getFramesSent();
+
+private:
+    void transposeFrames();
+
+    PhotonWS2812Pixel *strips[PIXEL_PARALLEL_MAX_STRIPS];
+    byte stripCount;
+    int pixelCount;
+    uint16_t *slots;  // pins to clear at T0H for each bit, in wire order
+    uint16_t laneMasks[PIXEL_PARALLEL_MAX_STRIPS / 8][256];  // transposed lane bits -> pin mask, per group of 8
+
+    volatile uint16_t *pinSet;
+    volatile uint16_t *pinReset;
+    uint16_t pinMask;  // all the strips' pins
+
+    uint32_t t0High;  // ticks from the start of a bit until a 0 goes low
+    uint32_t t1High;  // ... until a 1 goes low
+    uint32_t tBit;  // ... until the next bit starts
+    unsigned long endTime;
+    unsigned long framesSent;
+};
 
 
 // Accelerometer classes
+#define XL362_XYZT_BYTES 8  // XDATA_L..TEMP_H
+#define ADXL_FIFO_MAX_SAMPLES 40  // most XYZ samples drained from the FIFO in one burst (3 entries, 6 bytes each)
+#define XL362_BURST_MAX (ADXL_FIFO_MAX_SAMPLES * 6)  // largest burst transfer after the instruction and address
+#define ADXL_SPI_CLOCK 5  // MHz, the ADXL362 allows up to 8
+
 typedef void (MotionHandler)(bool motion, unsigned long after);
 
+
+#define ACCEL_FILTER_FRACTION 8  // filtered samples are raw * 256
+
+/* filters the x, y, z of a sample (in ACCEL_FILTER_FRACTION fixed point) in place, reset = first sample, fill the
+ * filter's state with it */
+typedef void (AccelFilterFunction)(AccelFilter *filter, int32_t sample[3], bool reset);
+
+struct AccelFilter {
+    AccelFilter(AccelFilterFunction *function) : function(function) {}
+
+    AccelFilterFunction *function;
+};
+
+/* filter stages for AccelFilterChain, each keeps its state as one array per axis */
+
+/* one-pole IIR: y += (x - y) * Alpha / 256, Alpha 1..256 (256 = no smoothing, 128 = 50/50 with the last sample) */
+template<uint16_t Alpha>
+struct AccelIIR {
+    static_assert(Alpha >= 1 && Alpha <= 256, "AccelIIR Alpha is 1..256");
+
+    inline void run(int32_t sample[3], bool reset) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (reset) y[axis] = sample[axis];
+            else y[axis] += ((sample[axis] - y[axis]) * Alpha) >> 8;
+            sample[axis] = y[axis];
+        }
+    }
+
+    int32_t y[3];
+};
+
+/* median of the last Taps (3 or 5) samples, drops single sample spikes */
+template<uint8_t Taps>
+struct AccelMedian {
+    static_assert(Taps == 3 || Taps == 5, "AccelMedian Taps is 3 or 5");
+
+    inline void run(int32_t sample[3], bool reset) {
+        if (reset) {
+            for (int axis = 0; axis < 3; axis++) {
+                for (int tap = 0; tap < Taps; tap++) history[axis][tap] = sample[axis];
+            }
+            index = 0;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            history[axis][index] = sample[axis];
+            // insertion sort a copy, at most 10 compares for 5 taps
+            int32_t sorted[Taps];
+            for (int tap = 0; tap < Taps; tap++) {
+                int32_t value = history[axis][tap];
+                int pos = tap;
+                for (; pos > 0 && sorted[pos - 1] > value; pos--) sorted[pos] = sorted[pos - 1];
+                sorted[pos] = value;
+            }
+            sample[axis] = sorted[Taps / 2];
+        }
+        if (++index == Taps) index = 0;
+    }
+
+    int32_t history[3][Taps];
+    uint8_t index;
+};
+
+/* mean of the last N samples, a running sum so it costs the same for any N */
+template<uint8_t N>
+struct AccelAverage {
+    static_assert(N >= 1, "AccelAverage N is at least 1");
+
+    inline void run(int32_t sample[3], bool reset) {
+        if (reset) {
+            for (int axis = 0; axis < 3; axis++) {
+                for (int tap = 0; tap < N; tap++) history[axis][tap] = sample[axis];
+                sum[axis] = sample[axis] * N;
+            }
+            index = 0;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            sum[axis] += sample[axis] - history[axis][index];
+            history[axis][index] = sample[axis];
+            sample[axis] = sum[axis] / N;
+        }
+        if (++index == N) index = 0;
+    }
+
+    int32_t history[3][N];
+    int32_t sum[3];
+    uint8_t index;
+};
+
+template<typename... Stages>
+struct AccelFilterStages {
+    inline void run(int32_t [3], bool) {}  // no stages left
+};
+
+template<typename First, typename... Rest>
+struct AccelFilterStages<First, Rest...> {
+    inline void run(int32_t sample[3], bool reset) {
+        first.run(sample, reset);
+        rest.run(sample, reset);
+    }
+
+    First first;
+    AccelFilterStages<Rest...> rest;
+};
+
+/* runs the given stages in order on every sample, the stages are inlined into one function, e.g.
+ * 'AccelFilterChain<AccelMedian<3>, AccelIIR<64>> filter;' then 'bb.startAccelerometer(1000/60, &filter);' */
+template<typename... Stages>
+struct AccelFilterChain : public AccelFilter {
+    AccelFilterChain() : AccelFilter(&run), stages() {}
+
+    static void run(AccelFilter *filter, int32_t sample[3], bool reset) {
+        static_cast<AccelFilterChain *>(filter)->stages.run(sample, reset);
+    }
+
+    AccelFilterStages<Stages...> stages;
+};
+
+
+#define ADXL_SAMPLE_RING_SIZE 64  // timestamped samples kept for readSamples()/encodeSamples(), a power of two
+
+/* encodeSamples() frames, little endian: 0xA5 0x5A, sample count (1..255), micros of the first sample (uint32), then
+ * per sample micros since the previous one (24 bits, 0 for the first; up to 16.7s so the slowest rates and adaptive
+ * polling still fill frames) and x, y, z (int16), then the low byte of the sum of all bytes from the count on; a
+ * longer gap between samples starts a new frame */
+#define ADXL_FRAME_SYNC0 0xA5
+#define ADXL_FRAME_SYNC1 0x5A
+#define ADXL_FRAME_HEADER_BYTES 7
+#define ADXL_FRAME_SAMPLE_BYTES 9
+#define ADXL_FRAME_MAX_DELTA 0xFFFFFF  // micros between samples in one frame
+#define ADXL_FRAME_MAX_SAMPLES 255
+#define ADXL_FRAME_BYTES(count) (ADXL_FRAME_HEADER_BYTES + (count) * ADXL_FRAME_SAMPLE_BYTES + 1)
+
+struct AccelSample {
+    unsigned long micros;  // when the sensor took it (estimated from the data rate for FIFO samples)
+    int16_t x, y, z;
+};
+
+
 class PhotonADXL362Accel {
 public:
     PhotonADXL362Accel(byte pin);
 
-    void setup(unsigned int refreshRate = 1000/10);
+    /* filter NULL = AccelIIR<128> (50/50 between the last two samples) */
+    void setup(unsigned int refreshRate = 1000/10, AccelFilter *filter = NULL);
 
     void update(system_tick_t millis);
 
+    /* the sensor's output data rate in Hz */
+    enum ODR: byte { ODR_12_5, ODR_25, ODR_50, ODR_100, ODR_200, ODR_400 };
+
+    /* sample at odr into the sensor's FIFO (stream mode, XYZ only so t isn't updated) and have update() drain a
+     * batch of up to ADXL_FIFO_MAX_SAMPLES in one burst every 'watermark' samples, every sample goes through motion
+     * detection; watermark 0 turns it off again (one sample per refresh), restarts/recalibrates if already running */
+    void setFIFO(ODR odr, uint16_t watermark);
+
+    /* samples drained from the FIFO so far */
+    unsigned long getFIFOSamples();
+
+    /* detect motion in the sensor (activity/inactivity in loop mode) instead of checking every sample, the sensor
+     * drives intPin (wired to its INT1) high while moving: motion changes come from the pin's interrupt and the
+     * sensor isn't read at all while still; threshold in raw units, 0 turns it off again, restarts if running;
+     * intPin needs an EXTI line of its own: not A1, which shares line 3 with button D4 (A7/WKP is free) */
+    void setActivityInterrupt(byte intPin, uint16_t threshold = ADXL_TOLERANCE,
+                              unsigned int inactiveTime = ADXL_INACTIVE_TIME);
+
+    /* poll every stillRefresh ms with the sensor at stillRate once notInMotion() reaches stillAfter ms, and go back to
+     * the refresh and data rate from setup()/setFIFO() on the first sample in motion; stillRefresh 0 turns it off;
+     * with the FIFO on it's at most ADXL_FIFO_MAX_SAMPLES sample periods at stillRate (3200ms at ODR_12_5) */
+    void setAdaptiveRate(unsigned int stillRefresh, unsigned int stillAfter = ADXL_STILL_AFTER,
+                         ODR stillRate = ODR_12_5);
+
+    /* samples taken while in motion and while still */
+    unsigned long getMotionSamples();
+    unsigned long getStillSamples();
+
+    /* raw samples waiting to be read, up to ADXL_SAMPLE_RING_SIZE; once full, newer samples are dropped (not the
+     * oldest, those belong to the reader) until some are read, see getDroppedSamples() */
+    int availableSamples();
+
+    /* copy up to count samples (oldest first) and remove them, returns how many, never blocks */
+    int readSamples(AccelSample *samples, int count);
+
+    /* read as many samples as fit in size bytes as ADXL_FRAME_ frames, returns the bytes used, size it with
+     * Serial.availableForWrite() so writing the frames never blocks */
+    int encodeSamples(byte *buffer, int size);
+
+    /* samples dropped because the ring was full */
+    unsigned long getDroppedSamples();
+
+    /* the millis at which update() next has work to do, DEADLINE_NONE if not started */
+    system_tick_t nextDeadline();
+
     /* set the callback function for when motion changes between in-motion and not-in-motion */
     void setMotionHandler(MotionHandler *handler);
 
@@ -398,31 +1128,53 @@ public:
     /* return true if within the initial calibration values */
     unsigned long notInMotion();
 
-    /* compute the pitch: ( ( arctan( x / squareroot( y^2 + z^2 ) ) * 180 ) / PI )  */
+    /* the orientation is computed once per sample from the filtered x, y, z with integer math, these just return it */
+
+    /* the pitch in degrees: ( ( arctan( x / squareroot( y^2 + z^2 ) ) * 180 ) / PI )  */
     double getPitch();
 
-    /* compute the roll: ( ( arctan( -y / z ) * 180 ) / PI )  */
+    /* the roll in degrees: ( ( arctan( -y / z ) * 180 ) / PI )  */
     double getRoll();
 
-    /* compute the current angle (0..359), 0 = right, 90 = top, 180 = left, 270 = bottom */
+    /* the pitch and roll as a signed phase (0x4000 = 90 degrees), see sin16 */
+    int16_t getPitchPhase();
+    int16_t getRollPhase();
+
+    /* the current angle (0..359), 0 = right, 90 = top, 180 = left, 270 = bottom */
     int getAngle();
 
-    /* conver the angle to azimuth (0..360), 0 = top, 90 = right, 180 = bottom, 270 = left */
+    /* the angle as azimuth (0..359), 0 = top, 90 = right, 180 = bottom, 270 = left */
     int getAzimuth();
 
+    /* the filtered x, y, z (by default weighted 50/50 between the last two updates, less 'jumpy'), converted from
+     * fixed point when called so the samples never go through floating point */
+    double getFilteredX();
+    double getFilteredY();
+    double getFilteredZ();
+
+    /* deprecated, use getFilteredX/Y/Z(): the same values, still converted after every sample for existing code */
+    double fx, fy, fz;
+
     /* direct access to current state */
     enum State: int { WAITING, STARTUP, RESET, POWER, CALIBRATING, RUNNING } state;
 
     /* direct access to x, y, z, and t (internal raw temperature value) */
     int16_t x, y, z, t;
 
-    /* direct access to fx, fy, fz (weighted 50/50 between the last two updates, less 'jumpy') */
-    double fx, fy, fz;
-
 private:
     void stateCalibrating();
 
-    void stateRunning();
+    void stateRunning(unsigned long elapsedMicros);
+
+    void updateOrientation();
+
+    void readFIFO();
+
+    void decodeFIFO();
+
+    void recordSample(unsigned long micros);
+
+    void updateRate(system_tick_t millis);
 
     byte spiRead8(byte regAddress);
 
@@ -430,6 +1182,21 @@ private:
 
     void spiReadXYZT();
 
+    void spiBurst(byte instruction, byte regAddress, int length, bool async);
+
+    void spiTransfer(int length, bool async);
+
+    void decodeXYZT();
+
+    static void spiBurstComplete();
+
+    void writeActivity();
+
+    static void activityInterrupt();
+
+    static PhotonADXL362Accel * volatile spiActive;  // the accelerometer with a DMA read in flight
+    static PhotonADXL362Accel * volatile activityAccel;  // the accelerometer on the activity interrupt
+
     int stateWait[6] = { 100, 100, 10, 10, 10, 0 };
 
     byte pin;
@@ -442,6 +1209,44 @@ private:
     unsigned long noMotionMillis;
     unsigned long nextUpdate;
     MotionHandler *motionHandler;
+
+    byte spiTx[2 + XL362_BURST_MAX];  // instruction, address, then data (zeros for reads)
+    byte spiRx[2 + XL362_BURST_MAX];
+    volatile bool sampleReady;  // set when an asynchronous XYZT or FIFO read completes
+    unsigned long readMicros;  // when the asynchronous read started, its sample(s) are stamped from it
+    unsigned long motionMicros;  // sub-millisecond remainder of the time accounted to motion/no motion
+
+    ODR dataRate;
+    uint16_t fifoWatermark;  // 0 = FIFO off
+    int fifoBytes;  // bytes of FIFO data in the read in flight
+    unsigned long fifoSamples;
+
+    byte activityPin;
+    uint16_t activityThreshold;  // 0 = motion detected in stateRunning()
+    unsigned int activityTime;
+    volatile bool activityChanged;  // set by the interrupt when the sensor's AWAKE output changes
+    bool awake;
+    system_tick_t sampleMillis;  // when motion time was last accounted
+
+    AccelFilterChain<AccelIIR<128>> defaultFilter;
+    AccelFilter *filter;
+    bool filterReset;  // the next sample starts the filter over
+    int32_t filtered[3];  // x, y, z in ACCEL_FILTER_FRACTION fixed point
+    int16_t pitchPhase, rollPhase;
+    int angle, azimuth;
+
+    AccelSample ring[ADXL_SAMPLE_RING_SIZE];
+    volatile uint16_t ringHead, ringTail;  // free running, written by update() and the reader respectively
+    unsigned long ringDropped;
+
+    ODR rate;  // what the sensor is running at, dataRate or stillRate
+    unsigned int runningRefresh;
+    unsigned int stillRefresh;  // 0 = not adaptive
+    unsigned int stillAfter;
+    ODR stillRate;
+    bool still;  // slowed down
+    bool moving;  // the last sample was in motion
+    unsigned long motionSamples, stillSamples;
 };
 
 
@@ -452,9 +1257,27 @@ private:
 #define XL362_XDATA_L       0x0E
 #define XL362_SOFT_RESET    0x1F
 #define XL362_POWER_CTL     0x2D
+#define XL362_FIFO_ENTRIES_L 0x0C
+#define XL362_STATUS        0x0B
+#define XL362_THRESH_ACT_L  0x20  // THRESH_ACT, TIME_ACT, THRESH_INACT, TIME_INACT then ACT_INACT_CTL follow
+#define XL362_INTMAP1       0x2A
+#define XL362_FIFO_CONTROL  0x28
+#define XL362_FIFO_SAMPLES  0x29
+#define XL362_FILTER_CTL    0x2C
+
+#define SPI_FIFO_INSTRUCTION 0x0D
+#define XL362_FIFO_MODE_STREAM  0b10
+#define XL362_FIFO_FLAG_AH  0b1000  // watermark bit 8
+#define XL362_FIFO_ENTRY_BYTES 2  // 2 bit axis tag and 14 bit sign extended value
+#define XL362_FIFO_ENTRIES_MAX 512
 
 #define XL362_POWER_FLAG_MEASURE_RUNING  0b10
 
+#define XL362_STATUS_AWAKE  0b1000000
+#define XL362_INTMAP_AWAKE  0b1000000
+#define XL362_ACT_INACT_LOOP  0b111111  // referenced activity and inactivity, loop mode (no acknowledging)
+#define XL362_ACTIVITY_BYTES 8  // THRESH_ACT_L..ACT_INACT_CTL
+
 
 
 #endif //BETTERPHOTONBUTTON_H
@@ -0,0 +1,26 @@
+#!/bin/sh
+# AccelDecodePty.sh <AccelDecode> <AccelStream>: streams 2 simulated seconds into the pseudo-terminal 'AccelDecode -p'
+# opens and checks it decodes 150 samples, the way frames come from a Photon on /dev/ttyACM0
+decode="$1"
+stream="$2"
+dir=$(mktemp -d) || exit 2
+trap 'kill $decoder 2>/dev/null; rm -rf "$dir"' EXIT
+
+"$decode" -p -n 150 > "$dir/samples.csv" 2> "$dir/decode.log" &
+decoder=$!
+# up to 5 seconds for the pseudo-terminal to open, and again for the decoder to finish once the frames are sent
+pts=""
+for tick in $(seq 50); do
+    pts=$(sed -n 's/^frames from //p' "$dir/decode.log")
+    [ -n "$pts" ] && break
+    sleep 0.1
+done
+[ -n "$pts" ] && "$stream" -t 2000 > "$pts"
+for tick in $(seq 50); do
+    kill -0 $decoder 2>/dev/null || break
+    sleep 0.1
+done
+cat "$dir/decode.log" >&2
+kill -0 $decoder 2>/dev/null && exit 1
+wait $decoder || exit 1
+[ "$(wc -l < "$dir/samples.csv")" -eq 151 ]
@@ -0,0 +1,60 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+#include "HostSimulation.h"
+
+/* a loop that sleeps exactly as long as update() says sees a change in acceleration within one refresh: the sample
+ * read in the background is handled as soon as it's in, not a refresh later, and is stamped when it was read */
+
+#define REFRESH 10  // ms, 100Hz
+#define MOVE_AT 2004  // ms
+
+int failures = 0;
+
+BetterPhotonButton bb = BetterPhotonButton();
+PhotonADXL362Accel *accel;
+system_tick_t motionAt = 0;
+unsigned long motionMicros = 0;
+
+void check(const char *name, bool ok) {
+    printf("%s %s\n", ok ? "ok" : "FAIL", name);
+    if (!ok) failures++;
+}
+
+void motion(bool moving, unsigned long) {
+    if (moving && !motionAt) {
+        motionAt = millis();
+        motionMicros = micros();
+    }
+}
+
+void setup() {
+    bb.setup();
+    accel = bb.startAccelerometer(REFRESH);
+    accel->setMotionHandler(&motion);
+    hostSetAcceleration(0, 0, 1000);
+    bool moved = false;
+    unsigned long movedMicros = 0;
+    AccelSample samples[ADXL_SAMPLE_RING_SIZE];
+    while (millis() < MOVE_AT + 200) {
+        system_tick_t wait = bb.update(millis());
+        // the first moved sample in the ring, it should be stamped when it was read
+        int count = accel->readSamples(samples, ADXL_SAMPLE_RING_SIZE);
+        for (int idx = 0; idx < count && !movedMicros; idx++) {
+            if (samples[idx].x > 250) movedMicros = samples[idx].micros;
+        }
+        hostAdvanceNanos(wait * 1000000ULL + 10000);  // sleep, plus 10us for the loop itself
+        if (!moved && millis() >= MOVE_AT) {
+            hostSetAcceleration(500, 0, 800);
+            moved = true;
+        }
+    }
+    printf("  motion at %lums, moved at %dms\n", (unsigned long) motionAt, MOVE_AT);
+    check("motion within one refresh", motionAt >= MOVE_AT && motionAt <= MOVE_AT + REFRESH + 1);
+
+    printf("  first moved sample at %luus\n", movedMicros);
+    check("moved sample stamped when read", movedMicros >= MOVE_AT * 1000UL && movedMicros <= motionMicros);
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
@@ -0,0 +1,68 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+#include "HostSimulation.h"
+
+/* a FIFO drain that starts part way through a sample (the FIFO overflowed and dropped the oldest entry, an x) still
+ * decodes every sample from its own x, y and z: each simulated sample has y = x + 1000 and z = x + 2000 */
+
+#define PERIOD 10  // ms at ODR_100
+#define OVERFLOW_SAMPLES 200  // 600 entries, more than the 512 the FIFO holds
+
+int failures = 0;
+
+BetterPhotonButton bb = BetterPhotonButton();
+PhotonADXL362Accel *accel;
+
+void check(const char *name, bool ok) {
+    printf("%s %s\n", ok ? "ok" : "FAIL", name);
+    if (!ok) failures++;
+}
+
+void run(unsigned long until) {
+    while (millis() < until) {
+        hostAdvanceNanos(1000000);
+        bb.update(millis());
+    }
+}
+
+void setup() {
+    bb.setup();
+    accel = bb.startAccelerometer();
+    accel->setFIFO(PhotonADXL362Accel::ODR_100, 10);
+    hostSetAcceleration(0, 1000, 2000);
+    run(1000);
+    check("running", accel->state == PhotonADXL362Accel::RUNNING);
+    AccelSample samples[ADXL_SAMPLE_RING_SIZE];
+    while (accel->readSamples(samples, ADXL_SAMPLE_RING_SIZE)) { }
+
+    // the sensor keeps sampling while nothing drains it, each sample different, until the FIFO overflows
+    for (int idx = 1; idx <= OVERFLOW_SAMPLES; idx++) {
+        hostSetAcceleration((int16_t) idx, (int16_t) (idx + 1000), (int16_t) (idx + 2000));
+        hostAdvanceNanos(PERIOD * 1000000ULL);
+        hostAccelSelect(true);  // the simulated sensor catches up on its samples when selected
+        hostAccelSelect(false);
+    }
+
+    int decoded = 0, mismatched = 0;
+    unsigned long until = millis() + 1000;
+    while (millis() < until) {
+        hostAdvanceNanos(1000000);
+        bb.update(millis());
+        int count = accel->readSamples(samples, ADXL_SAMPLE_RING_SIZE);
+        for (int idx = 0; idx < count; idx++) {
+            if (samples[idx].y != samples[idx].x + 1000 || samples[idx].z != samples[idx].x + 2000) {
+                if (!mismatched) printf("  sample %d is %d, %d, %d\n", decoded, samples[idx].x, samples[idx].y,
+                                        samples[idx].z);
+                mismatched++;
+            }
+            decoded++;
+        }
+    }
+    printf("  %d samples decoded after the overflow, %d mismatched\n", decoded, mismatched);
+    check("samples after the overflow", decoded >= 100);
+    check("every sample from its own x, y, z", !mismatched);
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
@@ -0,0 +1,72 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+#include "HostSimulation.h"
+
+/* encodeSamples() frames at a slow polling rate (100ms between samples, longer than a 16 bit micros delta holds)
+ * still carry many samples each, and a full sample ring keeps its unread (oldest) samples and drops the new ones */
+
+#define REFRESH 100  // ms between samples
+#define RUN_MILLIS 3000
+
+int failures = 0;
+
+BetterPhotonButton bb = BetterPhotonButton();
+PhotonADXL362Accel *accel;
+byte frames[ADXL_FRAME_BYTES(ADXL_SAMPLE_RING_SIZE)];
+
+void check(const char *name, bool ok) {
+    printf("%s %s\n", ok ? "ok" : "FAIL", name);
+    if (!ok) failures++;
+}
+
+uint32_t getLittleEndian(const byte *data, int bytes) {
+    uint32_t value = 0;
+    while (bytes--) value = (value << 8) | data[bytes];
+    return value;
+}
+
+void run(unsigned long until) {
+    while (millis() < until) {
+        hostAdvanceNanos(1000000);
+        bb.update(millis());
+    }
+}
+
+void testSlowFrames() {
+    run(RUN_MILLIS);
+    int samples = accel->availableSamples();
+    int length = accel->encodeSamples(frames, sizeof(frames));
+    check("samples recorded", samples >= RUN_MILLIS / REFRESH / 2);
+    check("one frame for all of them", length == ADXL_FRAME_BYTES(samples) && frames[2] == samples);
+    byte checksum = 0;
+    for (int idx = 2; idx < length - 1; idx++) checksum += frames[idx];
+    check("checksum", checksum == frames[length - 1]);
+    bool deltas = getLittleEndian(frames + ADXL_FRAME_HEADER_BYTES, 3) == 0;
+    for (int idx = 1; idx < samples; idx++) {
+        uint32_t delta = getLittleEndian(frames + ADXL_FRAME_HEADER_BYTES + idx * ADXL_FRAME_SAMPLE_BYTES, 3);
+        deltas &= delta >= (REFRESH - 1) * 1000UL && delta <= (REFRESH + 1) * 1000UL;
+    }
+    check("deltas of about 100ms", deltas);
+}
+
+void testFullRing() {
+    AccelSample samples[ADXL_SAMPLE_RING_SIZE];
+    unsigned long dropped = accel->getDroppedSamples();
+    unsigned long start = micros();
+    run(millis() + (ADXL_SAMPLE_RING_SIZE + 10) * REFRESH);
+    int read = accel->readSamples(samples, ADXL_SAMPLE_RING_SIZE);
+    check("ring full", read == ADXL_SAMPLE_RING_SIZE);
+    check("newest samples dropped", accel->getDroppedSamples() > dropped);
+    check("oldest samples kept", samples[0].micros - start < 2 * REFRESH * 1000UL);
+}
+
+void setup() {
+    bb.setup();
+    accel = bb.startAccelerometer(REFRESH);
+    testSlowFrames();
+    testFullRing();
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
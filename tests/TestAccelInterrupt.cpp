@@ -0,0 +1,47 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+#include "HostSimulation.h"
+
+/* the activity interrupt next to the button interrupts: the host, like the Photon, has one handler per EXTI line, so
+ * A1 (line 3, shared with button D4) is refused while the sensor's INT1 on HOST_ACCEL_INT1_PIN drives the handler */
+
+int failures = 0;
+
+BetterPhotonButton bb = BetterPhotonButton();
+PhotonADXL362Accel *accel;
+int starts = 0;
+
+void check(const char *name, bool ok) {
+    printf("%s %s\n", ok ? "ok" : "FAIL", name);
+    if (!ok) failures++;
+}
+
+void motion(bool moving, unsigned long) {
+    if (moving) starts++;
+}
+
+void unused() { }
+
+void setup() {
+    bb.setup();
+    bb.setButtonInterrupts(true);
+    check("A1 shares EXTI line 3 with D4", !attachInterrupt(A1, &unused, CHANGE));
+    check("A0 has a line of its own", attachInterrupt(A0, &unused, CHANGE));
+    detachInterrupt(A0);
+
+    accel = bb.startAccelerometer(10);
+    accel->setActivityInterrupt(HOST_ACCEL_INT1_PIN);
+    accel->setMotionHandler(&motion);
+    hostSetAcceleration(0, 0, 1000);
+    while (millis() < 3000) {
+        if (millis() >= 2000) hostSetAcceleration(500, 0, 1000);
+        bb.update(millis());
+        hostAccelUpdate();
+        delay(1);
+    }
+    check("INT1 drives the motion handler", starts == 1);
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
@@ -0,0 +1,73 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+#include "HostSimulation.h"
+#include <math.h>
+
+/* getPitch(), getRoll() and getAngle() (integer atan2_16/hypot16 on the filtered samples) against atan2/sqrt in
+ * double over a grid of x, y, z, and the deprecated fx, fy, fz against getFilteredX/Y/Z() */
+
+#define SETTLE 100  // ms at a 1ms refresh for the filter to reach the new value
+#define PITCH_ROLL_TOLERANCE 0.1  // degrees, atan2_16 plus the filter rounding the samples down by a fraction of 1 LSB
+#define ANGLE_TOLERANCE 1.5  // degrees, getAngle() is also truncated to a whole degree
+
+int failures = 0;
+
+BetterPhotonButton bb = BetterPhotonButton();
+PhotonADXL362Accel *accel;
+
+void check(const char *name, bool ok) {
+    printf("%s %s\n", ok ? "ok" : "FAIL", name);
+    if (!ok) failures++;
+}
+
+double degrees(double radians) { return radians * 180 / M_PI; }
+
+// the difference between two angles in degrees, across the wrap at 360
+double angleError(double a, double b) { return fabs(fmod(a - b + 540, 360) - 180); }
+
+void setup() {
+    static const int16_t grid[] = { -1000, -700, -300, 0, 300, 700, 1000 };
+    const int count = sizeof(grid) / sizeof(grid[0]);
+    bb.setup();
+    accel = bb.startAccelerometer(1);
+    while (accel->state != PhotonADXL362Accel::RUNNING) {
+        bb.update(millis());
+        delay(1);
+    }
+    double pitchError = 0, rollError = 0, angleWorst = 0;
+    bool legacy = true;
+    for (int ix = 0; ix < count; ix++) {
+        for (int iy = 0; iy < count; iy++) {
+            for (int iz = 0; iz < count; iz++) {
+                double x = grid[ix], y = grid[iy], z = grid[iz];
+                hostSetAcceleration(grid[ix], grid[iy], grid[iz]);
+                system_tick_t until = millis() + SETTLE;
+                while (millis() < until) {
+                    bb.update(millis());
+                    delay(1);
+                }
+                legacy = legacy && accel->fx == accel->getFilteredX() && accel->fy == accel->getFilteredY() &&
+                         accel->fz == accel->getFilteredZ();
+                // atan2(0, 0) has no direction, skip where the reference is undefined
+                if (x != 0 || y != 0 || z != 0) {
+                    pitchError = fmax(pitchError, fabs(accel->getPitch() - degrees(atan2(x, sqrt(y * y + z * z)))));
+                }
+                if (y != 0 || z != 0) {
+                    rollError = fmax(rollError, angleError(accel->getRoll(), degrees(atan2(-y, z))));
+                }
+                if (x != 0 || y != 0) {
+                    angleWorst = fmax(angleWorst, angleError(accel->getAngle(), degrees(atan2(y, x)) + 180));
+                }
+            }
+        }
+    }
+    printf("worst pitch %.3f roll %.3f angle %.3f degrees\n", pitchError, rollError, angleWorst);
+    check("pitch matches atan2(x, sqrt(y^2 + z^2))", pitchError <= PITCH_ROLL_TOLERANCE);
+    check("roll matches atan2(-y, z)", rollError <= PITCH_ROLL_TOLERANCE);
+    check("angle matches atan2(y, x) + 180", angleWorst <= ANGLE_TOLERANCE);
+    check("fx, fy, fz follow getFilteredX/Y/Z()", legacy);
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
@@ -0,0 +1,59 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+#include "HostSimulation.h"
+
+/* a loop slower than the refresh: the background read started by one update() is decoded by the next, its samples
+ * must be stamped when the read started, not when they were decoded a loop later (one sample and FIFO reads) */
+
+#define LOOP 45  // ms between update() calls
+#define SLACK 1000  // us from the start of update() to the read starting
+
+int failures = 0;
+
+BetterPhotonButton bb = BetterPhotonButton();
+PhotonADXL362Accel *accel;
+
+void check(const char *name, bool ok) {
+    printf("%s %s\n", ok ? "ok" : "FAIL", name);
+    if (!ok) failures++;
+}
+
+// runs the loop for a while once the sensor is running, true when every batch's newest sample was stamped by the
+// update() before the one that handed it over
+bool stampedWhenRead(const char *mode) {
+    while (accel->state != PhotonADXL362Accel::RUNNING) {
+        bb.update(millis());
+        delay(1);
+    }
+    AccelSample samples[ADXL_SAMPLE_RING_SIZE];
+    unsigned long previous = 0;
+    int batches = 0, late = 0;
+    for (int loops = 0; loops < 40; loops++) {
+        unsigned long started = micros();
+        bb.update(millis());
+        int count = accel->readSamples(samples, ADXL_SAMPLE_RING_SIZE);
+        if (count && previous) {
+            unsigned long newest = samples[count - 1].micros;
+            batches++;
+            if (newest < previous || newest > previous + SLACK) {
+                if (!late++) printf("  %s: newest sample at %luus, read at %luus\n", mode, newest, previous);
+            }
+        }
+        previous = started;
+        delay(LOOP);
+    }
+    return batches > 30 && !late;
+}
+
+void setup() {
+    bb.setup();
+    accel = bb.startAccelerometer(10);
+    hostSetAcceleration(0, 0, 1000);
+    check("one sample reads stamped when read", stampedWhenRead("XYZT"));
+    accel->setFIFO(PhotonADXL362Accel::ODR_100, 3);
+    check("FIFO reads stamped when read", stampedWhenRead("FIFO"));
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
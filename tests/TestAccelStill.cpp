@@ -0,0 +1,46 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+#include "HostSimulation.h"
+
+/* a still refresh longer than one FIFO drain can take (ADXL_FIFO_MAX_SAMPLES at the still rate) is capped, so the
+ * FIFO doesn't fill up between polls and overflow: every sample taken while still is drained */
+
+#define STILL_REFRESH 5000  // ms, 62 samples at 12.5Hz
+#define FROM 10000  // ms, well after the switch to the still rate
+#define UNTIL 70000
+
+int failures = 0;
+
+BetterPhotonButton bb = BetterPhotonButton();
+PhotonADXL362Accel *accel;
+
+void check(const char *name, bool ok) {
+    printf("%s %s\n", ok ? "ok" : "FAIL", name);
+    if (!ok) failures++;
+}
+
+void setup() {
+    bb.setup();
+    accel = bb.startAccelerometer();
+    accel->setFIFO(PhotonADXL362Accel::ODR_100, 10);
+    accel->setAdaptiveRate(STILL_REFRESH, 1000, PhotonADXL362Accel::ODR_12_5);
+    hostSetAcceleration(0, 0, 1000);
+    AccelSample samples[ADXL_SAMPLE_RING_SIZE];
+    unsigned long from = 0;
+    while (millis() < UNTIL) {
+        if (!from && millis() >= FROM) from = accel->getFIFOSamples();
+        bb.update(millis());
+        accel->readSamples(samples, ADXL_SAMPLE_RING_SIZE);
+        delay(1);
+    }
+    unsigned long drained = accel->getFIFOSamples() - from;
+    unsigned long taken = (UNTIL - FROM) / 80;
+    printf("  %lu samples drained, %lu taken\n", drained, taken);
+    // give or take the samples left in the FIFO at either end
+    check("every still sample drained",
+          drained + ADXL_FIFO_MAX_SAMPLES >= taken && drained <= taken + ADXL_FIFO_MAX_SAMPLES);
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
@@ -0,0 +1,186 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+
+/* The fixed point animations against the float math they replaced (done here in double as the reference): every
+ * color channel must be within 1 of it, for several strip lengths and cycle times, all the built in palettes and
+ * every millisecond of the cycle */
+
+#define MAX_PIXELS 60
+
+int failures = 0;
+
+/* the old PixelPalette::computeColorAt / PixelColor::interpolate / PixelColor::scale, in double; the second color is
+ * the one after the first (the old (int) (index + 1) rounds up to the color after that for an index a hair under a
+ * whole number, e.g. 0.99999999999999989 blends red into blue, a glitch the fixed point version doesn't copy) */
+PixelColor referenceColor(PixelPalette *palette, double index) {
+    int first = (int) index % palette->count;
+    int second = (first + 1) % palette->count;
+    double fraction = index - (int) index;
+    PixelColor a = palette->colors[first], b = palette->colors[second];
+    return PixelColor((byte) (fraction * (b.r - a.r) + a.r), (byte) (fraction * (b.g - a.g) + a.g),
+                      (byte) (fraction * (b.b - a.b) + a.b));
+}
+
+PixelColor referenceScale(PixelColor color, double value) {
+    return PixelColor((byte) min(color.r * value, 255.0), (byte) min(color.g * value, 255.0),
+                      (byte) min(color.b * value, 255.0));
+}
+
+double referenceStep(PixelAnimationData *data, double steps) {
+    return ((data->updated - data->start) % data->cycleMillis) * steps / data->cycleMillis;
+}
+
+void referenceFill(PixelAnimationData *data, PixelColor *out, PixelColor color) {
+    for (int idx = 0; idx < data->pixelCount; idx++) out[idx] = color;
+}
+
+void referenceBlink(PixelAnimationData *data, PixelColor *out) {
+    referenceFill(data, out, referenceScale(data->palette->colors[0], ((int) referenceStep(data, 2) + 1) % 2));
+}
+
+void referenceAlternating(PixelAnimationData *data, PixelColor *out) {
+    int step = (int) referenceStep(data, 2);
+    for (int idx = 0; idx < data->pixelCount; idx++) {
+        out[idx] = referenceScale(data->palette->colors[0], (step + idx) % 2);
+    }
+}
+
+void referenceFadeIn(PixelAnimationData *data, PixelColor *out) {
+    referenceFill(data, out, referenceScale(data->palette->colors[0], referenceStep(data, 1.0)));
+}
+
+void referenceFadeOut(PixelAnimationData *data, PixelColor *out) {
+    referenceFill(data, out, referenceScale(data->palette->colors[0], 1.0 - referenceStep(data, 1.0)));
+}
+
+void referenceGlow(PixelAnimationData *data, PixelColor *out) {
+    double scale = (-cos(referenceStep(data, M_PI * 2)) + 1.0) / 2.0;
+    referenceFill(data, out, referenceScale(data->palette->colors[0], scale));
+}
+
+void referenceFader(PixelAnimationData *data, PixelColor *out) {
+    referenceFill(data, out, referenceColor(data->palette, referenceStep(data, data->palette->count)));
+}
+
+void referenceIncrement(PixelAnimationData *data, PixelColor *out) {
+    int pixStep = (int) referenceStep(data, data->pixelCount);
+    PixelColor color = referenceColor(data->palette, referenceStep(data, data->palette->count));
+    for (int idx = 0; idx < data->pixelCount; idx++) out[idx] = referenceScale(color, idx == pixStep ? 1 : 0);
+}
+
+void referenceDecrement(PixelAnimationData *data, PixelColor *out) {
+    int pixStep = (int) referenceStep(data, data->pixelCount);
+    PixelColor color = referenceColor(data->palette, referenceStep(data, data->palette->count));
+    for (int idx = 0; idx < data->pixelCount; idx++) {
+        out[idx] = referenceScale(color, idx == (data->pixelCount - 1 - pixStep) ? 1 : 0);
+    }
+}
+
+void referenceBounce(PixelAnimationData *data, PixelColor *out) {
+    int pixStep = (int) referenceStep(data, 2 * data->pixelCount - 2);
+    PixelColor color = referenceColor(data->palette, referenceStep(data, data->palette->count));
+    for (int idx = 0; idx < data->pixelCount; idx++) {
+        int scale = (idx == (-abs(pixStep - data->pixelCount + 1) + data->pixelCount - 1)) ? 1 : 0;
+        out[idx] = referenceScale(color, scale);
+    }
+}
+
+void referenceScanner(PixelAnimationData *data, PixelColor *out) {
+    double tail = data->pixelCount / 4;
+    double step = referenceStep(data, 2 * data->pixelCount + ((tail * 4) - 1));
+    PixelColor color = referenceColor(data->palette, referenceStep(data, data->palette->count));
+    for (int idx = 0; idx < data->pixelCount; idx++) {
+        double scale = constrain((-abs((int) (abs((int) (step - data->pixelCount - 2 * tail)) - idx - tail)) + tail),
+                                 0, 1);
+        out[idx] = referenceScale(color, scale);
+    }
+}
+
+void referenceComet(PixelAnimationData *data, PixelColor *out) {
+    double tail = data->pixelCount / 2;
+    double pixStep = referenceStep(data, 2 * data->pixelCount - tail);
+    for (int idx = 0; idx < data->pixelCount; idx++) {
+        double palStep = max(pixStep - idx, 0.0) * (data->paletteCount() - 1) / (data->pixelCount / 1.75);
+        PixelColor color = referenceColor(data->palette, palStep);
+        double scale = constrain((((idx - pixStep) / tail + 1.25)) * (((idx - pixStep) < 0) ? 1 : 0), 0.0, 1.0);
+        out[idx] = referenceScale(color, scale);
+    }
+}
+
+void referenceGradient(PixelAnimationData *data, PixelColor *out) {
+    double step = data->pixelStep();
+    for (int idx = 0; idx < data->pixelCount; idx++) {
+        out[idx] = referenceColor(data->palette, (step + idx) * data->paletteCount() / data->pixelCount);
+    }
+}
+
+int channelError(PixelColor a, PixelColor b) {
+    return max(max(abs(a.r - b.r), abs(a.g - b.g)), abs(a.b - b.b));
+}
+
+void check(const char *name, PixelAnimation *animation, void (*reference)(PixelAnimationData *, PixelColor *)) {
+    PixelPalette *palettes[] = { &paletteBW, &paletteRGB, &paletteRYGB, &paletteRYGBStripe, &paletteRainbow };
+    int counts[] = { 11, 24, 60 };
+    long cycles[] = { 1000, 777 };
+    int error = 0;
+    PixelColor pixels[MAX_PIXELS], expected[MAX_PIXELS];
+    for (PixelPalette *palette : palettes) {
+        for (int count : counts) for (long cycle : cycles) {
+            PixelAnimationData data;
+            memset(&data, 0, sizeof(data));
+            data.pixelCount = count;
+            data.pixels = pixels;
+            data.palette = palette;
+            data.cycleMillis = cycle;
+            for (unsigned long millis = 0; millis < (unsigned long) cycle; millis++) {
+                data.updated = millis;
+                (*animation)(&data);
+                (*reference)(&data, expected);
+                for (int idx = 0; idx < count; idx++) {
+                    int pixelError = channelError(pixels[idx], expected[idx]);
+                    if (pixelError > 1 && pixelError > error) {
+                        printf("  %s: %d colors, %d pixels at %lums of %ld, pixel %d is %06lX, expected %06lX\n", name,
+                               palette->count, count, millis,
+                               cycle, idx, (unsigned long) pixels[idx].rgb(), (unsigned long) expected[idx].rgb());
+                    }
+                    error = max(error, pixelError);
+                }
+            }
+        }
+    }
+    printf("%s %s (max error %d)\n", error <= 1 ? "ok" : "FAIL", name, error);
+    if (error > 1) failures++;
+}
+
+void checkScaleFixed() {
+    int error = 0;
+    for (int value = 0; value <= 0x20000; value += 0x123) {
+        for (int channel = 0; channel < 256; channel += 5) {
+            PixelColor color((byte) channel, (byte) (255 - channel), (byte) (channel / 2));
+            error = max(error, channelError(color.scaleFixed((uint32_t) value),
+                                            referenceScale(color, value / 65536.0)));
+        }
+    }
+    printf("%s scaleFixed (max error %d)\n", error <= 1 ? "ok" : "FAIL", error);
+    if (error > 1) failures++;
+}
+
+void setup() {
+    checkScaleFixed();
+    check("animation_blink", &animation_blink, &referenceBlink);
+    check("animation_alternating", &animation_alternating, &referenceAlternating);
+    check("animation_fadeIn", &animation_fadeIn, &referenceFadeIn);
+    check("animation_fadeOut", &animation_fadeOut, &referenceFadeOut);
+    check("animation_glow", &animation_glow, &referenceGlow);
+    check("animation_fader", &animation_fader, &referenceFader);
+    check("animation_increment", &animation_increment, &referenceIncrement);
+    check("animation_decrement", &animation_decrement, &referenceDecrement);
+    check("animation_bounce", &animation_bounce, &referenceBounce);
+    check("animation_scanner", &animation_scanner, &referenceScanner);
+    check("animation_comet", &animation_comet, &referenceComet);
+    check("animation_gradient", &animation_gradient, &referenceGradient);
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
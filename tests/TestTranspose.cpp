@@ -0,0 +1,91 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+
+/* ws2812Transpose8 against a bit at a time transpose: bit i of out[k] is bit (7 - k) of in[i] */
+
+#define RANDOM_INPUTS 100000
+
+int failures = 0;
+
+void naiveTranspose8(const byte in[8], byte out[8]) {
+    for (int k = 0; k < 8; k++) {
+        out[k] = 0;
+        for (int i = 0; i < 8; i++) {
+            if (in[i] & (1 << (7 - k))) out[k] |= (byte) (1 << i);
+        }
+    }
+}
+
+bool check(const char *name, const byte in[8]) {
+    byte actual[8], expected[8];
+    ws2812Transpose8(in, actual);
+    naiveTranspose8(in, expected);
+    if (!memcmp(actual, expected, 8)) return true;
+    printf("FAIL %s\n  in      ", name);
+    for (int idx = 0; idx < 8; idx++) printf(" %02X", in[idx]);
+    printf("\n  actual  ");
+    for (int idx = 0; idx < 8; idx++) printf(" %02X", actual[idx]);
+    printf("\n  expected");
+    for (int idx = 0; idx < 8; idx++) printf(" %02X", expected[idx]);
+    printf("\n");
+    failures++;
+    return false;
+}
+
+void testEdgeCases() {
+    byte in[8];
+    bool ok = true;
+    memset(in, 0x00, 8);
+    ok &= check("all zeros", in);
+    memset(in, 0xFF, 8);
+    ok &= check("all ones", in);
+    // every single bit on its own, and every single bit off
+    for (int bit = 0; bit < 64; bit++) {
+        memset(in, 0x00, 8);
+        in[bit / 8] = (byte) (1 << (bit % 8));
+        ok &= check("single bit", in);
+        memset(in, 0xFF, 8);
+        in[bit / 8] = (byte) ~(1 << (bit % 8));
+        ok &= check("single bit off", in);
+    }
+    // diagonals (their own transposes), alternating rows and columns, one lane full
+    for (int idx = 0; idx < 8; idx++) in[idx] = (byte) (0x80 >> idx);
+    ok &= check("diagonal", in);
+    for (int idx = 0; idx < 8; idx++) in[idx] = (byte) (1 << idx);
+    ok &= check("anti-diagonal", in);
+    for (int idx = 0; idx < 8; idx++) in[idx] = idx & 1 ? 0xFF : 0x00;
+    ok &= check("alternating lanes", in);
+    for (int idx = 0; idx < 8; idx++) in[idx] = 0xAA;
+    ok &= check("alternating bits", in);
+    for (int lane = 0; lane < 8; lane++) {
+        memset(in, 0x00, 8);
+        in[lane] = 0xFF;
+        ok &= check("one lane", in);
+    }
+    printf("%s edge cases\n", ok ? "ok" : "FAIL");
+}
+
+void testRandom() {
+    uint32_t state = 0x2545F491;  // xorshift32, the same inputs every run
+    byte in[8];
+    bool ok = true;
+    for (int count = 0; count < RANDOM_INPUTS && ok; count++) {
+        for (int idx = 0; idx < 8; idx++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            in[idx] = (byte) state;
+        }
+        ok = check("random", in);
+    }
+    printf("%s %d random inputs\n", ok ? "ok" : "FAIL", RANDOM_INPUTS);
+}
+
+void setup() {
+    testEdgeCases();
+    testRandom();
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
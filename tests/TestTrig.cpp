@@ -0,0 +1,43 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+
+/* sin16/cos16 at every one of the 65536 phases and sin8/cos8 at every one of the 256 against sin()/cos(), within the
+ * bounds the header states (SIN16_MAX_ERROR, SIN8_MAX_ERROR) */
+
+int failures = 0;
+
+void check(const char *name, int error, int bound) {
+    printf("%s %s (max error %d, bound %d)\n", error <= bound ? "ok" : "FAIL", name, error, bound);
+    if (error > bound) failures++;
+}
+
+void testSin16() {
+    int sinError = 0, cosError = 0;
+    for (uint32_t phase = 0; phase <= 0xFFFF; phase++) {
+        double angle = phase * (2 * M_PI / 0x10000);
+        sinError = max(sinError, (int) ceil(fabs(sin16((uint16_t) phase) - 32767 * sin(angle))));
+        cosError = max(cosError, (int) ceil(fabs(cos16((uint16_t) phase) - 32767 * cos(angle))));
+    }
+    check("sin16", sinError, SIN16_MAX_ERROR);
+    check("cos16", cosError, SIN16_MAX_ERROR);
+}
+
+void testSin8() {
+    int sinError = 0, cosError = 0;
+    for (int phase = 0; phase <= 0xFF; phase++) {
+        double angle = phase * (2 * M_PI / 0x100);
+        sinError = max(sinError, (int) ceil(fabs(sin8((uint8_t) phase) - 127 * sin(angle))));
+        cosError = max(cosError, (int) ceil(fabs(cos8((uint8_t) phase) - 127 * cos(angle))));
+    }
+    check("sin8", sinError, SIN8_MAX_ERROR);
+    check("cos8", cosError, SIN8_MAX_ERROR);
+}
+
+void setup() {
+    testSin16();
+    testSin8();
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
@@ -0,0 +1,126 @@
+#pragma SPARK_NO_PREPROCESSOR
+#include "application.h"
+#include "BetterPhotonButton.h"
+
+/* ws2812Encode() and the SPI transmit mode's encoder against hand encoded line code: each WS2812 bit is 4 SPI
+ * bits, 0 = 1000 and 1 = 1110, two WS2812 bits per SPI byte, bytes in G, R, B order, then the reset bytes */
+
+int failures = 0;
+
+void checkBytes(const char *name, const byte *actual, const byte *expected, int length) {
+    for (int idx = 0; idx < length; idx++) {
+        if (actual[idx] != expected[idx]) {
+            printf("FAIL %s: byte %d is 0x%02X, expected 0x%02X\n", name, idx, actual[idx], expected[idx]);
+            failures++;
+            return;
+        }
+    }
+    printf("ok %s\n", name);
+}
+
+#define CODE_00 0x88, 0x88, 0x88, 0x88
+#define CODE_FF 0xEE, 0xEE, 0xEE, 0xEE
+#define CODE_A5 0xE8, 0xE8, 0x8E, 0x8E  // 10 10 01 01
+#define CODE_0F 0x88, 0x88, 0xEE, 0xEE  // 00 00 11 11
+#define CODE_80 0xE8, 0x88, 0x88, 0x88  // 10 00 00 00
+#define CODE_01 0x88, 0x88, 0x88, 0x8E  // 00 00 00 01
+
+PixelColor colors[3] = { PixelColor(0xFF, 0x00, 0xA5), PixelColor(0x0F, 0x80, 0x01), PixelColor(0, 0, 0) };
+
+void testEncode() {
+    byte buffer[3 * PIXEL_SPI_BYTES_PER_PIXEL];
+    const byte expected[] = {
+            CODE_00, CODE_FF, CODE_A5,  // g, r, b
+            CODE_80, CODE_0F, CODE_01,
+            CODE_00, CODE_00, CODE_00,
+    };
+    ws2812Encode(colors, 3, buffer);
+    checkBytes("ws2812Encode", buffer, expected, sizeof(expected));
+}
+
+void testTransmit() {
+    byte buffer[PIXEL_SPI_BUFFER_SIZE(3)];
+    memset(buffer, 0x55, sizeof(buffer));
+    PhotonWS2812Pixel strip(colors, 3, D2);
+    strip.setup();
+    strip.setupSPI(&SPI1, buffer);
+    strip.update(true);
+    byte expected[PIXEL_SPI_BUFFER_SIZE(3)] = {
+            CODE_00, CODE_FF, CODE_A5,
+            CODE_80, CODE_0F, CODE_01,
+            CODE_00, CODE_00, CODE_00,
+    };  // the rest are the zero reset bytes
+    checkBytes("encodeSPI GRB", buffer, expected, sizeof(expected));
+
+    // the adjusted path, RGB order at brightness 127: each level is (v * 128) >> 8
+    strip.setColorOrder(PhotonWS2812Pixel::RGB);
+    strip.setBrightness(127);
+    strip.update(true);
+    const byte adjusted[] = {
+            0x8E, 0xEE, 0xEE, 0xEE, CODE_00, 0x8E, 0x8E, 0x88, 0xE8,  // r 0x7F, g 0x00, b 0x52
+            0x88, 0x88, 0x8E, 0xEE, 0x8E, 0x88, 0x88, 0x88, CODE_00,  // r 0x07, g 0x40, b 0x00
+            CODE_00, CODE_00, CODE_00,
+    };
+    checkBytes("encodeSPI RGB brightness", buffer, adjusted, sizeof(adjusted));
+    checkBytes("encodeSPI reset bytes", buffer + sizeof(adjusted), expected + sizeof(adjusted),
+               PIXEL_SPI_RESET_BYTES);
+}
+
+void testForcedRefresh() {
+    // an unchanged frame is skipped on a normal refresh but resent when forced
+    byte buffer[PIXEL_SPI_BUFFER_SIZE(3)];
+    PhotonWS2812Pixel strip(colors, 3, D2);
+    strip.setup();
+    strip.setupSPI(&SPI1, buffer);
+    strip.update(true);
+    strip.triggerRefresh();
+    strip.update();
+    strip.update(true);
+    bool ok = strip.getFramesSent() == 2 && strip.getFramesSkipped() == 1;
+    printf("%s forced refresh resends (sent %lu, skipped %lu)\n", ok ? "ok" : "FAIL",
+           strip.getFramesSent(), strip.getFramesSkipped());
+    if (!ok) failures++;
+}
+
+void testMosiPin() {
+    // SPI output only comes out of MOSI, a strip on any other pin keeps bit-banging
+    byte buffer[PIXEL_SPI_BUFFER_SIZE(3)];
+    PhotonWS2812Pixel ring(colors, 3, D3), spiStrip(colors, 3, A5), spi1Strip(colors, 3, D2);
+    bool ok = !ring.setupSPI(&SPI1, buffer) && !ring.setupSPI(&SPI, buffer) && !spi1Strip.setupSPI(&SPI, buffer) &&
+              spiStrip.setupSPI(&SPI, buffer) && spi1Strip.setupSPI(&SPI1, buffer);
+    ring.update(true);
+    ok = ok && !ring.isTransmitting() && ring.getFramesSent() == 1;
+    printf("%s setupSPI only on the MOSI pin\n", ok ? "ok" : "FAIL");
+    if (!ok) failures++;
+}
+
+void __attribute__((noinline)) dirtyStack() {
+    volatile byte junk[4096];
+    for (unsigned int idx = 0; idx < sizeof(junk); idx++) junk[idx] = 0xAB;
+}
+
+void __attribute__((noinline)) testStackStrip() {
+    // a strip on the stack starts black (where dirtyStack() left garbage) and sends black
+    PhotonWS2812Strip<60, D2> strip;
+    bool black = true;
+    for (int idx = 0; idx < 60; idx++) black &= strip.pixels[idx] == PixelColor(0);
+    static byte buffer[PIXEL_SPI_BUFFER_SIZE(60)];
+    strip.setup();
+    strip.setupSPI(&SPI1, buffer);
+    strip.update(true);
+    for (unsigned int idx = 0; idx < sizeof(buffer) - PIXEL_SPI_RESET_BYTES; idx++) black &= buffer[idx] == 0x88;
+    printf("%s strip on the stack starts black\n", black ? "ok" : "FAIL");
+    if (!black) failures++;
+}
+
+void setup() {
+    testEncode();
+    testTransmit();
+    testForcedRefresh();
+    testMosiPin();
+    dirtyStack();
+    testStackStrip();
+    exit(failures ? 1 : 0);
+}
+
+void loop() { }
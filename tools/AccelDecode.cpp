@@ -0,0 +1,146 @@
+/*
+ * Decodes the accelerometer sample frames that PhotonADXL362Accel::encodeSamples() produces (see the AccelStream
+ * example) into CSV on stdout: micros,x,y,z.  Reads a file, stdin ('-', the default), a serial port such as
+ * /dev/ttyACM0 (put into raw mode) or, with -p, a new pseudo-terminal whose name it prints for the sender, e.g.
+ *
+ *   build/AccelDecode -p -n 500 > samples.csv      (prints 'frames from /dev/pts/3')
+ *   build/AccelStream -t 10000 > /dev/pts/3
+ *
+ * Bytes that aren't part of a frame with a good checksum are skipped.  -n stops after that many samples and exits
+ * with 1 if the input ended before them.  Counts of frames, samples and skipped bytes go to stderr.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "BetterPhotonButton.h"
+
+#define DECODE_BUFFER_SIZE (2 * ADXL_FRAME_BYTES(ADXL_FRAME_MAX_SAMPLES))
+
+struct DecodeCounts {
+    unsigned long frames;
+    unsigned long samples;
+    unsigned long skipped;
+};
+
+static uint32_t getLittleEndian(const uint8_t *data, int bytes) {
+    uint32_t value = 0;
+    while (bytes--) value = (value << 8) | data[bytes];
+    return value;
+}
+
+static int openInput(const char *path, bool pseudoTerminal) {
+    int fd;
+    if (pseudoTerminal) {
+        fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (fd < 0 || grantpt(fd) || unlockpt(fd)) return -1;
+        fprintf(stderr, "frames from %s\n", ptsname(fd));
+    } else if (!strcmp(path, "-")) {
+        fd = STDIN_FILENO;
+    } else {
+        fd = open(path, O_RDONLY | O_NOCTTY);
+        if (fd < 0) return -1;
+    }
+    if (isatty(fd)) {
+        // binary frames, no line editing, echo or newline translation
+        struct termios settings;
+        if (tcgetattr(fd, &settings) == 0) {
+            cfmakeraw(&settings);
+            tcsetattr(fd, TCSANOW, &settings);
+        }
+        if (pseudoTerminal) {
+            // keep the slave side open so there's no hangup between senders
+            int slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+            if (slave >= 0 && tcgetattr(slave, &settings) == 0) {
+                cfmakeraw(&settings);
+                tcsetattr(slave, TCSANOW, &settings);
+            }
+        }
+    }
+    return fd;
+}
+
+/* decodes the complete frames in data, returns how many bytes were used (the rest is an incomplete frame) */
+static int decodeFrames(const uint8_t *data, int length, DecodeCounts &counts, unsigned long limit) {
+    int pos = 0;
+    while (length - pos >= ADXL_FRAME_BYTES(1) && counts.samples < limit) {
+        const uint8_t *frame = data + pos;
+        int count = frame[2];
+        if (frame[0] != ADXL_FRAME_SYNC0 || frame[1] != ADXL_FRAME_SYNC1 || !count) {
+            pos++;
+            counts.skipped++;
+            continue;
+        }
+        int frameBytes = ADXL_FRAME_BYTES(count);
+        if (length - pos < frameBytes) break;
+        uint8_t checksum = 0;
+        for (int idx = 2; idx < frameBytes - 1; idx++) checksum += frame[idx];
+        if (checksum != frame[frameBytes - 1]) {
+            pos++;
+            counts.skipped++;
+            continue;
+        }
+        uint32_t micros = getLittleEndian(frame + 3, 4);
+        const uint8_t *sample = frame + ADXL_FRAME_HEADER_BYTES;
+        for (int idx = 0; idx < count && counts.samples < limit; idx++, sample += ADXL_FRAME_SAMPLE_BYTES) {
+            micros += getLittleEndian(sample, 3);
+            printf("%lu,%d,%d,%d\n", (unsigned long) micros,
+                   (int16_t) getLittleEndian(sample + 3, 2),
+                   (int16_t) getLittleEndian(sample + 5, 2),
+                   (int16_t) getLittleEndian(sample + 7, 2));
+            counts.samples++;
+        }
+        counts.frames++;
+        pos += frameBytes;
+    }
+    return pos;
+}
+
+int main(int argc, char **argv) {
+    const char *path = "-";
+    bool pseudoTerminal = false;
+    unsigned long limit = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p")) != -1) {
+        switch (opt) {
+            case 'n':
+                limit = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                pseudoTerminal = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n samples] [-p | file | device | -]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (optind < argc) path = argv[optind];
+
+    int fd = openInput(path, pseudoTerminal);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", pseudoTerminal ? "pseudo-terminal" : path, strerror(errno));
+        return 2;
+    }
+
+    DecodeCounts counts = { 0, 0, 0 };
+    uint8_t buffer[DECODE_BUFFER_SIZE];
+    int length = 0;
+    printf("micros,x,y,z\n");
+    while (!limit || counts.samples < limit) {
+        ssize_t got = read(fd, buffer + length, sizeof(buffer) - length);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        length += (int) got;
+        int used = decodeFrames(buffer, length, counts, limit ? limit : (unsigned long) -1);
+        memmove(buffer, buffer + used, (size_t) (length - used));
+        length -= used;
+        fflush(stdout);
+    }
+    fprintf(stderr, "%lu frames, %lu samples, %lu bytes skipped\n", counts.frames, counts.samples, counts.skipped);
+    return limit && counts.samples < limit ? 1 : 0;
+}